@@ -0,0 +1,202 @@
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <pqcpp/pqcpp.hpp>
+#include <pqcpp/detail/hdr_histogram.hpp>
+
+using namespace pqcpp;
+using clock_type = std::chrono::steady_clock;
+
+struct bench_option {
+	std::string conn_str;
+	std::string mode = "all";
+	int concurrency = 32;
+	int seconds = 10;
+	int threads = 1;
+	int stream_rows = 100000;
+	std::chrono::seconds warmup_timeout{ 10 };
+};
+
+struct bench_result {
+	std::mutex mutex;
+	detail::hdr_histogram<> latency_us;
+	std::uint64_t ops = 0;
+	std::uint64_t rows = 0;
+	std::uint64_t bytes = 0;
+	std::uint64_t errors = 0;
+};
+
+constexpr const char* io_backend() {
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+	return "io_uring";
+#else
+	return "epoll";
+#endif
+}
+
+awaitable<void> point_worker(std::shared_ptr<connection_pool> pool, clock_type::time_point deadline, bench_result& out) {
+	detail::hdr_histogram<> latency;
+	std::uint64_t ops = 0, errors = 0;
+	auto q = std::make_shared<query>("SELECT $1::int;");
+	q->set_name("point");
+	while (clock_type::now() < deadline) {
+		auto start = clock_type::now();
+		try {
+			auto conn = co_await pool->get(use_awaitable);
+			q->set_parameters(static_cast<int>(ops));
+			auto results = co_await conn->async_query(q, use_awaitable);
+			if (results.empty() || !results.front()->success()) {
+				++errors;
+				continue;
+			}
+		}
+		catch (...) {
+			++errors;
+			continue;
+		}
+		latency.record(std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count());
+		++ops;
+	}
+	std::unique_lock lock(out.mutex);
+	out.latency_us.merge(latency);
+	out.ops += ops;
+	out.errors += errors;
+}
+
+awaitable<void> stream_worker(std::shared_ptr<connection_pool> pool, int rows, clock_type::time_point deadline, bench_result& out) {
+	detail::hdr_histogram<> latency;
+	std::uint64_t ops = 0, total_rows = 0, bytes = 0, errors = 0;
+	auto q = std::make_shared<query>(fmt::format(
+		"SELECT g, md5(g::text) FROM generate_series(1, {}) g;", rows));
+	q->set_name("stream");
+	while (clock_type::now() < deadline) {
+		auto start = clock_type::now();
+		try {
+			// 经服务端游标分批读取, 客户端不必一次持有整个结果
+			auto conn = co_await pool->get(use_awaitable);
+			auto c = co_await detail::open_read_only_cursor(conn, q, transaction::READ_COMMITTED, {});
+			while (auto batch = co_await c->next()) {
+				total_rows += batch->row_count();
+				bytes += batch->memory_size();
+			}
+			co_await detail::close_read_only_cursor(conn, c);
+		}
+		catch (...) {
+			++errors;
+			continue;
+		}
+		latency.record(std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count());
+		++ops;
+	}
+	std::unique_lock lock(out.mutex);
+	out.latency_us.merge(latency);
+	out.ops += ops;
+	out.rows += total_rows;
+	out.bytes += bytes;
+	out.errors += errors;
+}
+
+void report(const std::string& name, const bench_option& opt, bench_result& r) {
+	double seconds = opt.seconds;
+	fmt::print(
+		"{:<8} backend={} concurrency={} threads={} ops/s={:.0f} p50={}us p99={}us p999={}us max={}us",
+		name, io_backend(), opt.concurrency, opt.threads, r.ops / seconds,
+		r.latency_us.percentile(50), r.latency_us.percentile(99),
+		r.latency_us.percentile(99.9), r.latency_us.max()
+	);
+	if (r.rows) {
+		fmt::print(" rows/s={:.0f} MB/s={:.1f}", r.rows / seconds, r.bytes / seconds / 1048576);
+	}
+	fmt::print(" errors={}\n", r.errors);
+}
+
+void run(const std::string& name, const bench_option& opt) {
+	boost::asio::io_context io(opt.threads);
+	connection_pool_option pool_opt;
+	pool_opt.min_size = opt.concurrency;
+	pool_opt.max_size = opt.concurrency;
+	pool_opt.name = "bench";
+	auto pool = connection_pool::make(io, opt.conn_str, pool_opt);
+	bench_result result;
+
+	// 等待连接建立后再计时; 连接池建连失败会一直重试, 预热限时, 失败则退出
+	std::atomic_int warm{ 0 }, warm_failed{ 0 };
+	for (int i = 0; i < opt.concurrency; ++i) {
+		co_spawn(io, [pool, &warm, &warm_failed]() -> awaitable<void> {
+			try {
+				auto conn = co_await pool->get(use_awaitable);
+				throw_if_error(co_await conn->async_query("SELECT 1;"));
+			}
+			catch (...) {
+				++warm_failed;
+			}
+			++warm;
+		}, detached);
+	}
+	auto warm_deadline = clock_type::now() + opt.warmup_timeout;
+	while (warm < opt.concurrency && clock_type::now() < warm_deadline) {
+		io.run_one_for(std::chrono::milliseconds(100));
+	}
+	if (warm < opt.concurrency || warm_failed) {
+		throw std::runtime_error(fmt::format(
+			"{}: warm-up failed ({} of {} connections ready)", name, warm - warm_failed, opt.concurrency));
+	}
+
+	auto deadline = clock_type::now() + std::chrono::seconds(opt.seconds);
+	std::atomic_int done{ 0 };
+	for (int i = 0; i < opt.concurrency; ++i) {
+		co_spawn(io, [&, pool]() -> awaitable<void> {
+			if (name == "point") {
+				co_await point_worker(pool, deadline, result);
+			}
+			else {
+				co_await stream_worker(pool, opt.stream_rows, deadline, result);
+			}
+			// 连接池的定时器会让 io 一直有任务, 全部结束后主动停止
+			if (++done == opt.concurrency) {
+				io.stop();
+			}
+		}, detached);
+	}
+	std::vector<std::thread> threads;
+	for (int i = 1; i < opt.threads; ++i) {
+		threads.emplace_back([&io] { io.run(); });
+	}
+	io.run();
+	for (auto& t : threads) {
+		t.join();
+	}
+	report(name, opt, result);
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: pqcpp_bench <conn_str> [point|stream|all] [concurrency] [seconds] [threads] [stream_rows]\n";
+		return 1;
+	}
+	logger()->set_level(spdlog::level::warn);
+	bench_option opt;
+	opt.conn_str = argv[1];
+	if (argc > 2) opt.mode = argv[2];
+	if (argc > 3) opt.concurrency = std::stoi(argv[3]);
+	if (argc > 4) opt.seconds = std::stoi(argv[4]);
+	if (argc > 5) opt.threads = std::stoi(argv[5]);
+	if (argc > 6) opt.stream_rows = std::stoi(argv[6]);
+
+	try {
+		if (opt.mode == "point" || opt.mode == "all") {
+			run("point", opt);
+		}
+		if (opt.mode == "stream" || opt.mode == "all") {
+			auto stream_opt = opt;
+			stream_opt.concurrency = std::max(1, opt.concurrency / 4);
+			run("stream", stream_opt);
+		}
+	}
+	catch (const std::exception& ex) {
+		std::cerr << ex.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,186 @@
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <pqcpp/pqcpp.hpp>
+
+// 不连接数据库, 以录制的 pgoutput 消息和二进制格式值驱动解码器
+
+using namespace pqcpp;
+
+namespace {
+
+	int failures = 0;
+
+	void check(bool ok, const char* expr, int line) {
+		if (!ok) {
+			fmt::print(stderr, "decode_check.cpp:{}: check failed: {}\n", line, expr);
+			++failures;
+		}
+	}
+
+#define CHECK(expr) check((expr), #expr, __LINE__)
+
+	template <typename F>
+	bool throws(F f) {
+		try {
+			f();
+		}
+		catch (const std::exception&) {
+			return true;
+		}
+		return false;
+	}
+
+	std::string from_hex(std::string_view hex) {
+		std::string out;
+		for (std::size_t i = 0; i + 1 < hex.size(); i += 2) {
+			out.push_back(static_cast<char>(std::stoi(std::string(hex.substr(i, 2)), nullptr, 16)));
+		}
+		return out;
+	}
+
+	// public.orders(id bigint 主键, note text, amount numeric) 上一个事务的 pgoutput(proto_version 1) 消息
+	constexpr std::string_view relation_msg =
+		"52000040017075626c6963006f7264657273006400030169640000000014ffffffff006e6f74650000000019ffffffff00616d6f756e7400000006a4ffffffff";
+	constexpr std::string_view begin_msg = "4200000016b374d848000000141dd76000000002db";
+	constexpr std::string_view insert_msg = "49000040014e000374000000023432740000000568656c6c6f6e";
+	constexpr std::string_view update_msg =
+		"55000040014f000374000000023432740000000568656c6c6f6e4e000374000000023432757400000004392e3530";
+	constexpr std::string_view remove_msg = "44000040014b0003740000000234326e6e";
+	constexpr std::string_view truncate_msg = "54000000010000004001";
+	constexpr std::string_view commit_msg = "430000000016b374d84800000016b374d880000000141dd76000";
+	constexpr std::string_view origin_msg = "4f00000000000000007800";
+
+	void check_pgoutput() {
+		pgoutput_decoder decoder;
+		CHECK(throws([&] { decoder.decode(from_hex(insert_msg), 1); }));
+
+		auto rel = decoder.decode(from_hex(relation_msg), 1);
+		CHECK(rel && rel->kind == change_kind::relation);
+		CHECK(rel->rel->schema == "public" && rel->rel->name == "orders");
+		CHECK(rel->rel->columns.size() == 3);
+		CHECK(rel->rel->columns[0].key && rel->rel->columns[0].type_oid == 20);
+		CHECK(!rel->rel->columns[1].key && rel->rel->columns[2].name == "amount");
+
+		auto begin = decoder.decode(from_hex(begin_msg), 2);
+		CHECK(begin && begin->kind == change_kind::begin);
+		CHECK(begin->xid == 731 && begin->commit_lsn == parse_lsn("16/B374D848"));
+		CHECK(begin->commit_time == detail::from_pg_timestamp(86400LL * 1000000));
+		CHECK(decoder.in_transaction());
+
+		auto insert = decoder.decode(from_hex(insert_msg), 3);
+		CHECK(insert && insert->kind == change_kind::insert && insert->xid == 731);
+		CHECK(insert->new_tuple->get<std::int64_t>("id") == 42);
+		CHECK(insert->new_tuple->get("note") == "hello");
+		CHECK(insert->new_tuple->is_null(2));
+
+		auto update = decoder.decode(from_hex(update_msg), 4);
+		CHECK(update && update->kind == change_kind::update);
+		CHECK(update->old_tuple && update->old_tuple->get("note") == "hello");
+		CHECK(update->new_tuple->is_unchanged(1));
+		CHECK(update->new_tuple->get<double>("amount") == 9.5);
+
+		auto remove = decoder.decode(from_hex(remove_msg), 5);
+		CHECK(remove && remove->kind == change_kind::remove && !remove->new_tuple);
+		CHECK(remove->old_tuple->get<std::int64_t>(0) == 42 && remove->old_tuple->is_null(1));
+
+		auto truncate = decoder.decode(from_hex(truncate_msg), 6);
+		CHECK(truncate && truncate->kind == change_kind::truncate);
+		CHECK(truncate->truncated.size() == 1 && truncate->truncated[0]->name == "orders");
+
+		CHECK(!decoder.decode(from_hex(origin_msg), 7));
+
+		auto commit = decoder.decode(from_hex(commit_msg), 8);
+		CHECK(commit && commit->kind == change_kind::commit);
+		CHECK(commit->end_lsn == parse_lsn("16/B374D880"));
+		CHECK(!decoder.in_transaction() && decoder.delivered_lsn() == commit->end_lsn);
+
+		CHECK(throws([&] { decoder.decode(from_hex(insert_msg).substr(0, 12), 9); }));
+	}
+
+	std::shared_ptr<type_registry> make_registry() {
+		auto type = [](Oid oid, std::string name, char kind, char category) {
+			pg_type_info info;
+			info.oid = oid;
+			info.schema = oid < 16384 ? "pg_catalog" : "public";
+			info.name = std::move(name);
+			info.kind = kind;
+			info.category = category;
+			return info;
+		};
+		auto registry = type_registry::make();
+		registry->add(type(23, "int4", 'b', 'N'));
+		registry->add(type(25, "text", 'b', 'S'));
+		auto range = type(3904, "int4range", 'r', 'R');
+		range.subtype = 23;
+		registry->add(std::move(range));
+		auto status = type(16400, "order_status", 'e', 'E');
+		status.labels = { "open", "closed" };
+		registry->add(std::move(status));
+		auto zipcode = type(16401, "zipcode", 'd', 'N');
+		zipcode.base = 23;
+		registry->add(std::move(zipcode));
+		auto address = type(16410, "address", 'c', 'C');
+		address.attributes = { { "street", 25 }, { "zip", 16401 }, { "status", 16400 } };
+		registry->add(std::move(address));
+		return registry;
+	}
+
+	// address 值 ('Main', 12345, 'open') 及 int4range 值的二进制格式
+	constexpr std::string_view address_value =
+		"0000000300000019000000044d61696e00000017000000040000303900004010000000046f70656e";
+	constexpr std::string_view record_with_null = "0000000200000019ffffffff000000170000000400000007";
+	constexpr std::string_view range_value = "02000000040000000a0000000400000014";
+	constexpr std::string_view range_upper_infinite = "120000000400000005";
+	constexpr std::string_view range_empty = "01";
+
+	template <typename T>
+	T decode(const type_registry& registry, Oid type, const std::string& bytes) {
+		return binary_codec<T>::decode(registry, type, bytes.data(), static_cast<int>(bytes.size()));
+	}
+
+	void check_binary() {
+		auto registry = make_registry();
+		CHECK(registry->resolve(16401) == 23);
+		CHECK(registry->is_textual(16400) && !registry->is_textual(16401));
+
+		auto address = from_hex(address_value);
+		auto [street, zip, status] = decode<std::tuple<std::string, int, std::string>>(*registry, 16410, address);
+		CHECK(street == "Main" && zip == 12345 && status == "open");
+		CHECK(throws([&] { decode<std::tuple<std::string, int>>(*registry, 16410, address); }));
+
+		auto composite = decode<pg_composite>(*registry, 16410, address);
+		CHECK(composite.size() == 3);
+		CHECK(composite.get("street") == "Main");
+		CHECK(composite.get<int>("zip") == 12345);
+		CHECK(composite.field_index("status") == 2);
+		CHECK(throws([&] { composite.get(1); }));
+		CHECK(throws([&] { composite.get("missing"); }));
+
+		auto record = decode<pg_composite>(*registry, type_oid::record, from_hex(record_with_null));
+		CHECK(record.is_null(0) && record.get(0).empty());
+		CHECK(record.get<std::optional<int>>(1) == 7);
+
+		auto range = decode<pg_range<int>>(*registry, 3904, from_hex(range_value));
+		CHECK(!range.empty && range.lower_inclusive && !range.upper_inclusive);
+		CHECK(range.lower == 10 && range.upper == 20);
+
+		auto half_open = decode<pg_range<int>>(*registry, 3904, from_hex(range_upper_infinite));
+		CHECK(half_open.lower == 5 && !half_open.upper);
+
+		CHECK(decode<pg_range<int>>(*registry, 3904, from_hex(range_empty)).empty);
+		CHECK(throws([&] { decode<pg_range<int>>(*registry, 23, from_hex(range_value)); }));
+	}
+
+}
+
+int main() {
+	check_pgoutput();
+	check_binary();
+	if (failures) {
+		fmt::print(stderr, "{} check(s) failed\n", failures);
+		return 1;
+	}
+	fmt::print("all decode checks passed\n");
+	return 0;
+}
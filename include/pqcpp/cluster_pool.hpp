@@ -0,0 +1,540 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <pqcpp/connection_pool.hpp>
+#include <pqcpp/detail/hdr_histogram.hpp>
+#include <pqcpp/detail/waiter_list.hpp>
+#include <pqcpp/result.hpp>
+#include <pqcpp/error.hpp>
+#include <pqcpp/logger.hpp>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 对冲读选项
+	 *
+	 * 只读查询超过已观测延迟分位值仍未返回时, 向另一个副本发送相同查询,
+	 * 先返回者胜出, 另一方以 CancelRequest 取消. 仅用于幂等的只读查询
+	 */
+	struct hedge_option {
+		bool enabled = false;
+		// 触发对冲的延迟分位值
+		double percentile = 95;
+		// 对冲延迟的下限/上限, 样本不足时使用下限
+		std::chrono::milliseconds min_delay{ 2 };
+		std::chrono::milliseconds max_delay{ 1000 };
+		// 开始使用分位值所需的最少样本数
+		std::size_t min_samples = 100;
+		// 统计窗口样本数, 满后重新统计
+		std::size_t window = 10000;
+	};
+
+	namespace detail {
+
+		/**
+		 * @brief 滑动窗口延迟分位值, 线程安全
+		 */
+		class latency_percentile {
+		public:
+			explicit latency_percentile(const hedge_option& opt)
+				:m_percentile(opt.percentile), m_min_samples(std::max<std::size_t>(opt.min_samples, 1)),
+				m_window(std::max(opt.window, m_min_samples))
+			{}
+
+			void record(std::chrono::steady_clock::duration d) {
+				auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+				std::unique_lock lock(m_mutex);
+				m_histogram.record(static_cast<std::uint64_t>(std::max<std::int64_t>(us, 0)));
+				auto count = m_histogram.count();
+				// 样本数每翻倍及窗口满时更新, 避免每次记录都遍历直方图
+				if (count >= m_min_samples && (count == m_next_update || count >= m_window)) {
+					m_value.store(static_cast<std::int64_t>(m_histogram.percentile(m_percentile)), std::memory_order_relaxed);
+					m_next_update = count * 2;
+				}
+				if (count >= m_window) {
+					m_histogram = hdr_histogram<>();
+					m_next_update = m_min_samples;
+				}
+			}
+
+			/**
+			 * @brief 当前分位值(微秒), 样本不足时为 -1
+			 */
+			std::int64_t value() const {
+				return m_value.load(std::memory_order_relaxed);
+			}
+
+		private:
+			double m_percentile;
+			std::size_t m_min_samples;
+			std::size_t m_window;
+			std::mutex m_mutex;
+			hdr_histogram<> m_histogram;
+			std::uint64_t m_next_update{ m_min_samples };
+			std::atomic<std::int64_t> m_value{ -1 };
+		};
+
+	}
+
+	struct cluster_pool_option {
+		// 初始主库连接字符串, 故障切换后以 pg_is_in_recovery() 的探测结果为准
+		std::string primary;
+		std::vector<std::string> replicas;
+		// 每个节点的连接池选项, name 作为指标标签前缀
+		connection_pool_option pool;
+		// 角色/延迟探测周期, 探测使用每个节点独立的连接
+		std::chrono::milliseconds probe_interval{ 2000 };
+		// 单次探测超时, 建连超时请在连接字符串中设置 connect_timeout
+		std::chrono::milliseconds probe_timeout{ 1000 };
+		// 探测延迟 EWMA 平滑系数
+		double latency_alpha = 0.3;
+		// 没有可用副本时只读请求落到主库
+		bool fallback_to_primary = true;
+		// execute() 对只读查询启用对冲
+		hedge_option hedge;
+	};
+
+	/**
+	 * @brief 主从集群连接池
+	 *
+	 * 每个节点一个 connection_pool. 只读请求(query::read_only() 或 READ ONLY 事务)路由到副本,
+	 * 在两个随机副本中选择 探测延迟 x (借出数 + 1) 较小者; 其他请求路由到主库.
+	 * 节点角色由周期性的 pg_is_in_recovery() 探测确定, 故障切换后自动跟随新主库
+	 */
+	class cluster_pool : public std::enable_shared_from_this<cluster_pool> {
+	public:
+		using conn_ptr = connection_pool::conn_ptr;
+		using executor_type = boost::asio::any_io_executor;
+
+		struct node {
+			std::string conn_str;
+			std::shared_ptr<connection_pool> pool;
+			std::atomic_bool primary{ false };
+			std::atomic_bool healthy{ true };
+			// 探测延迟 EWMA(微秒)
+			std::atomic<double> latency_us{ 0 };
+			// 经 cluster_pool 借出的连接数
+			std::atomic_int inflight{ 0 };
+		};
+
+		static std::shared_ptr<cluster_pool> make(executor_type executor, const cluster_pool_option& option) {
+			std::shared_ptr<cluster_pool> pool(new cluster_pool(std::move(executor), option));
+			pool->start_probes();
+			return pool;
+		}
+
+		static std::shared_ptr<cluster_pool> make(boost::asio::io_context& io, const cluster_pool_option& option) {
+			return make(io.get_executor(), option);
+		}
+
+		cluster_pool(const cluster_pool&) = delete;
+		cluster_pool& operator=(const cluster_pool&) = delete;
+
+		/**
+		 * @brief 从指定节点借出连接, n 为空时以 NO_AVAILABLE_NODE 失败
+		 *
+		 * @param n nodes() 中的节点
+		 */
+		template <typename CompletionToken>
+		auto get_from(std::shared_ptr<node> n, CompletionToken&& token) {
+			return boost::asio::async_initiate<
+				CompletionToken,
+				void(boost::system::error_code, conn_ptr)
+			>(
+				[self = shared_from_this(), n = std::move(n)](auto handler) {
+					if (!n) {
+						auto ex = boost::asio::get_associated_executor(handler, self->m_executor);
+						boost::asio::post(ex, [handler = std::move(handler)]() mutable {
+							handler(error::make_error_code(error::pqcpp_ec::NO_AVAILABLE_NODE), nullptr);
+						});
+						return;
+					}
+					++n->inflight;
+					auto on_get = [n, handler = std::move(handler)](error_code ec, conn_ptr conn) mutable {
+						if (ec) {
+							--n->inflight;
+							handler(ec, nullptr);
+							return;
+						}
+						handler(ec, track(n, std::move(conn)));
+					};
+					n->pool->get(std::move(on_get));
+				},
+				token
+			);
+		}
+
+		/**
+		 * @brief 按访问模式获取连接
+		 *
+		 * @param access READ_ONLY 路由到副本
+		 * @param token void(boost::system::error_code, conn_ptr)
+		 */
+		template <typename CompletionToken>
+		auto get(transaction::access access, CompletionToken&& token) {
+			return get_from(select(access), std::forward<CompletionToken>(token));
+		}
+
+		template <typename CompletionToken>
+		auto get(CompletionToken&& token) {
+			return get(transaction::READ_WRITE, std::forward<CompletionToken>(token));
+		}
+
+		/**
+		 * @brief 执行单条查询, 按 query::read_only() 路由; 开启 hedge 时只读查询走 execute_hedged()
+		 */
+		awaitable<std::vector<std::shared_ptr<result>>> execute(std::shared_ptr<query> q) {
+			if (q->read_only() && m_option.hedge.enabled) {
+				co_return co_await execute_hedged(std::move(q));
+			}
+			auto conn = co_await get(q->read_only() ? transaction::READ_ONLY : transaction::READ_WRITE, use_awaitable);
+			co_return co_await conn->async_query(q, use_awaitable);
+		}
+
+		/**
+		 * @brief 对冲执行只读查询
+		 *
+		 * 先在选出的副本上执行, 超过对冲延迟(观测延迟分位值)仍未完成时在另一个副本上再执行一次,
+		 * 返回先完成的结果并取消另一方. 查询须是幂等的; 没有其他可用副本时不对冲
+		 */
+		awaitable<std::vector<std::shared_ptr<result>>> execute_hedged(std::shared_ptr<query> q) {
+			auto first = select(transaction::READ_ONLY);
+			if (!first) {
+				throw boost::system::system_error(error::make_error_code(error::pqcpp_ec::NO_AVAILABLE_NODE));
+			}
+			auto state = std::make_shared<hedge_state>();
+			state->pending = 1;
+			co_spawn(m_executor, attempt(shared_from_this(), first, q, state), detached);
+			if (!co_await wait_hedge(state, hedge_delay())) {
+				auto second = select(transaction::READ_ONLY, first.get());
+				bool hedge = false;
+				if (second) {
+					// 超时与第一次尝试完成可能同时发生, 已完成时不再对冲
+					std::unique_lock lock(state->mutex);
+					if (!state->done) {
+						++state->pending;
+						++state->hedged;
+						hedge = true;
+					}
+				}
+				if (hedge) {
+					m_hedges.fetch_add(1, std::memory_order_relaxed);
+					co_spawn(m_executor, attempt(shared_from_this(), second, q, state), detached);
+				}
+				co_await wait_hedge(state, std::chrono::microseconds::max());
+			}
+			std::unique_lock lock(state->mutex);
+			if (state->error) {
+				std::rethrow_exception(state->error);
+			}
+			co_return std::move(state->results);
+		}
+
+		/**
+		 * @brief 当前对冲延迟
+		 */
+		std::chrono::microseconds hedge_delay() const {
+			auto lower = std::chrono::duration_cast<std::chrono::microseconds>(m_option.hedge.min_delay);
+			auto upper = std::chrono::duration_cast<std::chrono::microseconds>(m_option.hedge.max_delay);
+			auto value = m_read_latency.value();
+			if (value < 0) {
+				return lower;
+			}
+			return std::clamp(std::chrono::microseconds(value), lower, std::max(lower, upper));
+		}
+
+		/**
+		 * @brief 已发出的对冲请求数
+		 */
+		std::size_t hedge_count() const {
+			return m_hedges.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief 在按访问模式选出的连接上执行事务, READ_ONLY 事务路由到副本
+		 *
+		 * 副本(hot standby)拒绝 SERIALIZABLE, 路由到副本的 SERIALIZABLE 降为 REPEATABLE_READ;
+		 * 回落到主库时保持 SERIALIZABLE
+		 *
+		 * @param f awaitable<T>(conn_ptr)
+		 */
+		template <typename F>
+		auto transaction(transaction::level level, transaction::access access, F f)
+			-> std::invoke_result_t<F&, conn_ptr> {
+			auto n = select(access);
+			if (n && !n->primary && level == transaction::SERIALIZABLE) {
+				level = transaction::REPEATABLE_READ;
+			}
+			auto conn = co_await get_from(std::move(n), use_awaitable);
+			auto body = [&f, conn]() {
+				return f(conn);
+			};
+			if constexpr (concept::is_void_coroutine_function_v<decltype(body)>) {
+				co_await conn->transaction(level, access, body);
+			}
+			else {
+				co_return co_await conn->transaction(level, access, body);
+			}
+		}
+
+		template <typename F>
+		auto read_only_transaction(F f) -> std::invoke_result_t<F&, conn_ptr> {
+			return this->transaction(transaction::REPEATABLE_READ, transaction::READ_ONLY, std::move(f));
+		}
+
+		const std::vector<std::shared_ptr<node>>& nodes() const {
+			return m_nodes;
+		}
+
+		/**
+		 * @brief 当前主库, 未探测到时为空
+		 */
+		std::shared_ptr<node> primary() const {
+			for (const auto& n : m_nodes) {
+				if (n->primary && n->healthy) {
+					return n;
+				}
+			}
+			return nullptr;
+		}
+
+	private:
+		struct hedge_state {
+			std::mutex mutex;
+			bool done{ false };
+			int pending{ 0 };
+			int hedged{ 0 };
+			std::vector<std::shared_ptr<result>> results;
+			std::exception_ptr error;
+			// 已开始执行查询的连接, 结束后用于取消落败的一方
+			std::vector<conn_ptr> conns;
+			detail::waiter_list waiters;
+		};
+
+		/**
+		 * @brief 在节点上执行一次尝试, 第一个成功(或最后一个失败)的尝试完成对冲
+		 */
+		static awaitable<void> attempt(
+			std::shared_ptr<cluster_pool> self,
+			std::shared_ptr<node> n,
+			std::shared_ptr<query> q,
+			std::shared_ptr<hedge_state> state
+		) {
+			std::vector<std::shared_ptr<result>> results;
+			std::exception_ptr error;
+			conn_ptr conn;
+			try {
+				auto raw = co_await n->pool->get(use_awaitable);
+				++n->inflight;
+				conn = track(n, std::move(raw));
+				{
+					std::unique_lock lock(state->mutex);
+					if (state->done) {
+						co_return;
+					}
+					state->conns.push_back(conn);
+				}
+				auto start = std::chrono::steady_clock::now();
+				results = co_await conn->async_query(q, use_awaitable);
+				self->m_read_latency.record(std::chrono::steady_clock::now() - start);
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			std::vector<std::function<void()>> waiters;
+			std::vector<conn_ptr> losers;
+			{
+				std::unique_lock lock(state->mutex);
+				--state->pending;
+				if (state->done) {
+					// 落败方已被取消; 查询先于取消请求完成时, 取消可能作用于该连接的下一条查询, 丢弃连接
+					bool canceled = std::any_of(results.begin(), results.end(), [](const auto& r) {
+						return r->sql_state() == sqlstate::query_canceled;
+					});
+					if (!error && !canceled) {
+						boost::asio::post(conn->get_strand(), [conn]() {
+							conn->disconnect();
+						});
+					}
+					co_return;
+				}
+				if (error && state->pending > 0) {
+					co_return;
+				}
+				state->done = true;
+				state->results = std::move(results);
+				state->error = error;
+				waiters = state->waiters.take();
+				for (auto& c : state->conns) {
+					if (c != conn) {
+						losers.push_back(std::move(c));
+					}
+				}
+				state->conns.clear();
+			}
+			for (const auto& c : losers) {
+				c->cancel_query();
+			}
+			detail::waiter_list::notify(std::move(waiters));
+		}
+
+		/**
+		 * @brief 等待对冲完成或超时, 完成时取消超时定时器
+		 *
+		 * @return awaitable<bool> 是否已完成
+		 */
+		static awaitable<bool> wait_hedge(std::shared_ptr<hedge_state> state, std::chrono::microseconds timeout) {
+			return detail::wait_until(state, &hedge_state::waiters, [](const hedge_state& s) {
+				return s.done;
+			}, timeout == std::chrono::microseconds::max() ? std::chrono::steady_clock::duration::max() : timeout);
+		}
+
+		cluster_pool(executor_type executor, const cluster_pool_option& option)
+			:m_executor(std::move(executor)), m_option(option), m_read_latency(option.hedge)
+		{
+			add_node(option.primary, true, "primary");
+			for (std::size_t i = 0; i < option.replicas.size(); ++i) {
+				add_node(option.replicas[i], false, fmt::format("replica{}", i));
+			}
+		}
+
+		void add_node(const std::string& conn_str, bool primary, const std::string& role) {
+			auto n = std::make_shared<node>();
+			n->conn_str = conn_str;
+			n->primary = primary;
+			auto opt = m_option.pool;
+			opt.name = fmt::format("{}-{}", m_option.pool.name, role);
+			n->pool = connection_pool::make(m_executor, conn_str, opt);
+			m_nodes.push_back(std::move(n));
+		}
+
+		/**
+		 * @brief 借出的连接归还时减少节点借出数
+		 */
+		static conn_ptr track(std::shared_ptr<node> n, conn_ptr conn) {
+			struct holder {
+				std::shared_ptr<node> n;
+				conn_ptr conn;
+				~holder() {
+					conn.reset();
+					--n->inflight;
+				}
+			};
+			auto h = std::make_shared<holder>();
+			h->n = std::move(n);
+			h->conn = std::move(conn);
+			return conn_ptr(h, h->conn.get());
+		}
+
+		static double score(const node& n) {
+			// 未完成探测时延迟为 0, 借出数仍参与比较
+			return (n.latency_us.load(std::memory_order_relaxed) + 1) * (n.inflight.load(std::memory_order_relaxed) + 1);
+		}
+
+		/**
+		 * @param exclude 不参与选择的节点, 对冲时排除第一次尝试的副本且不回落到主库
+		 */
+		std::shared_ptr<node> select(transaction::access access, const node* exclude = nullptr) {
+			if (access == transaction::READ_ONLY) {
+				thread_local std::vector<node*> candidates;
+				candidates.clear();
+				for (const auto& n : m_nodes) {
+					if (!n->primary && n->healthy && n.get() != exclude) {
+						candidates.push_back(n.get());
+					}
+				}
+				if (!candidates.empty()) {
+					thread_local std::minstd_rand rng{ std::random_device{}() };
+					std::uniform_int_distribution<std::size_t> dist(0, candidates.size() - 1);
+					auto a = candidates[dist(rng)];
+					auto b = candidates[dist(rng)];
+					auto chosen = score(*a) <= score(*b) ? a : b;
+					for (const auto& n : m_nodes) {
+						if (n.get() == chosen) {
+							return n;
+						}
+					}
+				}
+				if (!m_option.fallback_to_primary || exclude) {
+					return nullptr;
+				}
+			}
+			return primary();
+		}
+
+		void start_probes() {
+			for (const auto& n : m_nodes) {
+				co_spawn(m_executor, probe(weak_from_this(), n, m_executor, m_option), detached);
+			}
+		}
+
+		/**
+		 * @brief 周期性探测节点角色和延迟, 集群池销毁后退出
+		 */
+		static awaitable<void> probe(
+			std::weak_ptr<cluster_pool> weak,
+			std::shared_ptr<node> n,
+			executor_type executor,
+			cluster_pool_option option
+		) {
+			static const auto q = std::make_shared<query>("SELECT pg_is_in_recovery();");
+			std::shared_ptr<connection> conn;
+			while (!weak.expired()) {
+				bool ok = false;
+				try {
+					if (!conn || !conn->is_ready()) {
+						conn = connection::make(n->conn_str, executor);
+						co_await conn->async_connect(use_awaitable);
+					}
+					// 超时后断开探测连接, 使进行中的查询失败. 定时器可能在查询完成、cancel() 之前已到期,
+					// 断开前在 strand 上确认查询仍未返回(查询的发送先于此处投递到 strand, 此时已进入 io_engine)
+					boost::asio::steady_timer deadline(executor, option.probe_timeout);
+					deadline.async_wait([conn](const error_code& ec) {
+						if (!ec) {
+							boost::asio::post(conn->get_strand(), [conn]() {
+								if (conn->inflight() > 0) {
+									conn->disconnect();
+								}
+							});
+						}
+					});
+					auto start = std::chrono::steady_clock::now();
+					auto results = co_await conn->async_query(q, use_awaitable);
+					deadline.cancel();
+					throw_if_error(results);
+					auto us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+					double prev = n->latency_us.load(std::memory_order_relaxed);
+					n->latency_us.store(prev == 0 ? us : prev + option.latency_alpha * (us - prev), std::memory_order_relaxed);
+					bool in_recovery = results.front()->row_count() > 0 && results.front()->get_value(0, 0)[0] == 't';
+					if (n->primary != !in_recovery) {
+						PQCPP_LOG_INFO("cluster node {} role changed to {}", n->pool->option().name, in_recovery ? "replica" : "primary");
+					}
+					n->primary = !in_recovery;
+					ok = true;
+				}
+				catch (const std::exception& ex) {
+					PQCPP_LOG_WARN("cluster node {} probe failed: {}", n->pool->option().name, ex.what());
+					conn.reset();
+				}
+				n->healthy = ok;
+				boost::asio::steady_timer timer(executor, option.probe_interval);
+				co_await timer.async_wait(use_awaitable);
+			}
+		}
+
+	private:
+		executor_type m_executor;
+		cluster_pool_option m_option;
+		std::vector<std::shared_ptr<node>> m_nodes;
+		// 只读查询延迟, 用于计算对冲延迟
+		detail::latency_percentile m_read_latency;
+		std::atomic_size_t m_hedges{ 0 };
+	};
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+namespace pqcpp {
+
+	struct concurrency_limit_option {
+		enum algorithm_type {
+			// 超时/失败时乘性减小, 否则加性增大
+			aimd,
+			// 按长期延迟与短期延迟之比(梯度)调整, 类 Vegas
+			gradient
+		};
+
+		algorithm_type algorithm = gradient;
+		int initial_limit = 4;
+		// 小于 1 时按 1 处理, 否则 limit 降到 0 后不再放行查询, 也就不再有样本使其回升
+		int min_limit = 1;
+		// 实际上限同时受连接池 max_size 约束
+		int max_limit = 256;
+
+		// aimd: 延迟超过最小延迟的倍数视为过载
+		double aimd_latency_tolerance = 2.0;
+		// aimd: 过载时的乘性减小比例
+		double aimd_backoff_ratio = 0.9;
+		// aimd: 每隔多少样本重新探测最小延迟
+		int aimd_probe_interval = 1000;
+
+		// gradient: 允许长期延迟相对短期延迟上涨的倍数
+		double gradient_tolerance = 1.5;
+		// gradient: 长期延迟平均窗口(样本数)
+		int gradient_long_window = 600;
+		// gradient: 新旧 limit 的平滑系数
+		double gradient_smoothing = 0.2;
+	};
+
+	/**
+	 * @brief 自适应并发限制
+	 *
+	 * 依据查询延迟样本估算数据库在延迟明显恶化前能承受的最大并发量,
+	 * 线程安全, 可同时被多个连接上报样本
+	 */
+	class concurrency_limiter {
+	public:
+		explicit concurrency_limiter(const concurrency_limit_option& option)
+			:m_option(normalize(option)),
+			m_estimated(std::clamp(m_option.initial_limit, m_option.min_limit, m_option.max_limit)),
+			m_limit(static_cast<int>(m_estimated))
+		{}
+
+		/**
+		 * @brief 当前允许的并发量
+		 */
+		int limit() const {
+			return m_limit.load(std::memory_order_relaxed);
+		}
+
+		int inflight() const {
+			return m_inflight.load(std::memory_order_relaxed);
+		}
+
+		void on_acquire() {
+			m_inflight.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void on_release() {
+			m_inflight.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief 上报一次查询延迟
+		 *
+		 * @param latency 查询耗时
+		 * @param success false 表示网络/协议错误
+		 */
+		void on_sample(std::chrono::nanoseconds latency, bool success) {
+			double rtt = std::chrono::duration<double, std::micro>(latency).count();
+			int inflight = this->inflight();
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_option.algorithm == concurrency_limit_option::aimd) {
+				update_aimd(rtt, success, inflight);
+			}
+			else {
+				update_gradient(rtt, success, inflight);
+			}
+			m_estimated = std::clamp<double>(m_estimated, m_option.min_limit, m_option.max_limit);
+			m_limit.store(static_cast<int>(m_estimated), std::memory_order_relaxed);
+		}
+
+	private:
+		static concurrency_limit_option normalize(concurrency_limit_option option) {
+			option.min_limit = std::max(option.min_limit, 1);
+			option.max_limit = std::max(option.max_limit, option.min_limit);
+			return option;
+		}
+
+		void update_aimd(double rtt, bool success, int inflight) {
+			if (m_samples++ % m_option.aimd_probe_interval == 0 || rtt < m_min_rtt) {
+				m_min_rtt = rtt;
+			}
+			if (!success || rtt > m_min_rtt * m_option.aimd_latency_tolerance) {
+				m_estimated *= m_option.aimd_backoff_ratio;
+			}
+			else if (inflight * 2 >= m_estimated) {
+				m_estimated += 1.0 / m_estimated;
+			}
+		}
+
+		void update_gradient(double rtt, bool success, int inflight) {
+			if (!success) {
+				m_estimated *= 0.9;
+				return;
+			}
+			int window = std::max(1, m_option.gradient_long_window);
+			if (m_samples < window) {
+				++m_samples;
+				m_long_rtt += (rtt - m_long_rtt) / m_samples;
+			}
+			else {
+				m_long_rtt += (rtt - m_long_rtt) / window;
+			}
+			// 长期延迟明显高于当前时说明负载已回落, 加速收敛
+			if (m_long_rtt / rtt > 2) {
+				m_long_rtt *= 0.95;
+			}
+			// 未用满时不再放大, 避免 limit 无限漂移
+			if (inflight < m_estimated / 2) {
+				return;
+			}
+			double gradient = std::clamp(m_option.gradient_tolerance * m_long_rtt / rtt, 0.5, 1.0);
+			double queue_size = std::sqrt(m_estimated);
+			double target = m_estimated * gradient + queue_size;
+			m_estimated = m_estimated * (1 - m_option.gradient_smoothing) + target * m_option.gradient_smoothing;
+		}
+
+	private:
+		concurrency_limit_option m_option;
+		std::mutex m_mutex;
+		double m_estimated;
+		double m_min_rtt{ 0 };
+		double m_long_rtt{ 0 };
+		long long m_samples{ 0 };
+		std::atomic<int> m_limit;
+		std::atomic<int> m_inflight{ 0 };
+	};
+
+}
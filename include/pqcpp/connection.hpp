@@ -5,6 +5,8 @@
 #include <limits>
 #include <atomic>
 #include <optional>
+#include <chrono>
+#include <functional>
 #include <boost/asio.hpp>
 #include <libpq-fe.h>
 #include <fmt/format.h>
@@ -15,45 +17,72 @@
 #include <pqcpp/result.hpp>
 #include <pqcpp/connection_option.hpp>
 #include <pqcpp/error.hpp>
+#include <pqcpp/io_stats.hpp>
 #include <pqcpp/transaction.hpp>
 #include <pqcpp/detail/connect_op.hpp>
 #include <pqcpp/detail/query_op.hpp>
+#include <pqcpp/detail/copy_op.hpp>
+#include <pqcpp/detail/io_engine.hpp>
 #include <pqcpp/coro.hpp>
 #include <pqcpp/detail/concept.hpp>
 
 namespace pqcpp {
 
+	namespace detail {
+		/**
+		 * @brief 发送取消请求的后台线程, PQcancel 会阻塞建连
+		 */
+		inline boost::asio::thread_pool& cancel_pool() {
+			static boost::asio::thread_pool pool(1);
+			return pool;
+		}
+	}
+
 	class connection : public std::enable_shared_from_this<connection> {
 		friend class connection_pool;
 		using error_code = boost::system::error_code;
 	public:
 		using socket_type = boost::asio::ip::tcp::socket;
-		using strand_type = boost::asio::strand<boost::asio::io_context::executor_type>;
+		using executor_type = boost::asio::any_io_executor;
+		using strand_type = boost::asio::strand<executor_type>;
 
 		using response_success_handle = std::function<void(const std::vector<std::shared_ptr<pqcpp::result>>&)>;
 		using response_failure_handle = std::function<void(const std::string&)>;
+		using query_observer = std::function<void(const query_stats&)>;
+		using notification_handler = detail::io_engine::notification_handler;
 
 		/**
 		 * @brief 创建连接
 		 *
 		 * @param opt 连接选项
-		 * @param io
+		 * @param executor 连接 I/O 所在的 executor, 可为 io_context/thread_pool 的 executor 或自定义 executor
 		 * @return std::shared_ptr<connection>
 		 */
+		static std::shared_ptr<connection> make(const std::string& conn_str, executor_type executor) {
+			return std::shared_ptr<connection>{ new connection(conn_str, std::move(executor)) };
+		}
+
+		static std::shared_ptr<connection> make(const connection_options& opts, executor_type executor) {
+			return make(opts.get_conn_str(), std::move(executor));
+		}
+
 		static std::shared_ptr<connection> make(const std::string& conn_str, boost::asio::io_context& io) {
-			return std::shared_ptr<connection>{ new connection(conn_str, io) };
+			return make(conn_str, io.get_executor());
 		}
 
 		static std::shared_ptr<connection> make(const connection_options& opts, boost::asio::io_context& io) {
-			return std::shared_ptr<connection>{ new connection(opts.get_conn_str(), io) };
+			return make(opts.get_conn_str(), io.get_executor());
 		}
 
 		~connection() {
-			if (m_native_conn) {
-				PQfinish(m_native_conn);
+			// 读等待持有 engine, 在 strand 上关闭以释放
+			if (m_engine->socket()) {
+				boost::asio::post(m_strand, [engine = m_engine]() {
+					engine->close();
+				});
 			}
 			--total_;
-			logger()->trace("connection {} destroy, total {}", m_id, total_);
+			PQCPP_LOG_TRACE("connection {} destroy, total {}", m_id, total_);
 		}
 
 		connection(const connection&) = delete;
@@ -68,16 +97,31 @@ namespace pqcpp {
 			return m_conn_str;
 		}
 
+		const executor_type& get_executor() const {
+			return m_executor;
+		}
+
 		strand_type& get_strand() {
 			return m_strand;
 		}
 
 		socket_type& get_socket() {
-			return *m_socket;
+			return *m_engine->socket();
 		}
 
 		void set_socket(std::unique_ptr<socket_type>&& socket) {
-			m_socket = std::move(socket);
+			m_engine->set_socket(std::move(socket));
+		}
+
+		detail::io_engine& get_engine() {
+			return *m_engine;
+		}
+
+		/**
+		 * @brief 连接建立后开始持续读, 须在 strand 上调用
+		 */
+		void start_io() {
+			m_engine->start();
 		}
 
 		/**
@@ -86,31 +130,138 @@ namespace pqcpp {
 		 * @return ::pg_conn*
 		 */
 		::pg_conn* get_native_conn() {
-			return m_native_conn;
+			return m_engine->native_conn();
 		}
 
 		std::string error_message() {
-			return ::PQerrorMessage(m_native_conn);
+			return ::PQerrorMessage(m_engine->native_conn());
 		}
 
 		void set_native_conn(PGconn* native_conn) {
-			m_native_conn = native_conn;
+			m_engine->set_native_conn(native_conn);
 		}
 
 		/**
-		 * @brief 连接是否就绪
+		 * @brief 连接是否就绪, 可在任意线程调用
 		 *
 		 * @return true
 		 * @return false
 		 */
-		bool is_ready() {
-			return m_native_conn && m_socket && (PQstatus(m_native_conn) == CONNECTION_OK);
+		bool is_ready() const {
+			return m_engine->ready();
+		}
+
+		/**
+		 * @brief 最近一个操作完成时的事务状态, 可在任意线程调用
+		 */
+		PGTransactionStatusType transaction_status() const {
+			return m_engine->transaction_status();
 		}
 
 		std::size_t id() const {
 			return m_id;
 		}
 
+		/**
+		 * @brief 多路复用模式
+		 *
+		 * 开启后并发的 async_query 在连接 strand 上排队, 以 libpq 管道模式背靠背发送,
+		 * 结果按发送顺序交回各自的调用者; 一个连接即可承载大量并发的轻量查询.
+		 * 每条查询单独 sync, 失败不影响其他查询; 只能使用单条语句(扩展协议),
+		 * 事务仍需独占连接
+		 */
+		void set_multiplexed(bool enable) {
+			m_multiplexed = enable;
+		}
+
+		bool multiplexed() const {
+			return m_multiplexed;
+		}
+
+		/**
+		 * @brief 已发送尚未返回结果的查询数, 须在 strand 上调用
+		 */
+		std::size_t inflight() const {
+			return m_engine->pending();
+		}
+
+		/**
+		 * @brief 设置查询完成回调
+		 *
+		 * @param observer void(const query_stats&), 在连接 strand 上调用
+		 */
+		void set_query_observer(query_observer observer) {
+			m_query_observer = std::move(observer);
+		}
+
+		bool has_query_observer() const {
+			return static_cast<bool>(m_query_observer);
+		}
+
+		/**
+		 * @brief 记录与语句一起发送的 COMMIT 失败, 由 transaction() 结束时抛出
+		 */
+		void note_commit_failure(std::shared_ptr<result> res) {
+			m_commit_failure = std::move(res);
+		}
+
+		void notify_query_done(const query_stats& stats) {
+			m_query_count.fetch_add(1, std::memory_order_relaxed);
+			if (m_query_observer) {
+				m_query_observer(stats);
+			}
+		}
+
+		/**
+		 * @brief 设置异步通知(LISTEN/NOTIFY)回调
+		 *
+		 * 通知在连接空闲时处理, 回调在连接 strand 上调用; 接收通知的连接不宜归还连接池
+		 *
+		 * @param handler void(const PGnotify&)
+		 */
+		void set_notification_handler(notification_handler handler) {
+			boost::asio::post(m_strand, [engine = m_engine, handler = std::move(handler)]() mutable {
+				engine->set_notification_handler(std::move(handler));
+			});
+		}
+
+		/**
+		 * @brief 本连接已完成的查询数
+		 *
+		 * @return std::size_t
+		 */
+		std::size_t query_count() const {
+			return m_query_count.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief I/O 计数快照, 可在任意线程调用
+		 *
+		 * @return io_counters
+		 */
+		io_counters io_stats() const {
+			return m_engine->stats().snapshot(query_count() - m_io_stats_query_base.load(std::memory_order_relaxed));
+		}
+
+		/**
+		 * @brief 开启后统计每次唤醒的可读字节数和空唤醒(每次唤醒多一次 FIONREAD)
+		 */
+		void enable_io_detail(bool enable) {
+			m_engine->stats().enable_detail(enable);
+		}
+
+		/**
+		 * @brief 清零 I/O 计数; query_count() 为连接生命周期计数不清零, 快照中的查询数自此重新计
+		 */
+		void reset_io_stats() {
+			m_engine->stats().reset();
+			m_io_stats_query_base.store(query_count(), std::memory_order_relaxed);
+		}
+
+		detail::io_stats& get_io_stats() {
+			return m_engine->stats();
+		}
+
 		/**
 		 * @brief 获取锁
 		 *
@@ -133,7 +284,7 @@ namespace pqcpp {
 				void(boost::system::error_code)
 			>(
 				detail::connect_op<connection>(*this),
-				std::forward<CompletionToken>(token), this->m_io
+				std::forward<CompletionToken>(token), this->m_executor
 			);
 		}
 
@@ -146,12 +297,103 @@ namespace pqcpp {
 		template <typename CompletionToken>
 		auto async_query(std::shared_ptr<query> query, CompletionToken&& token) {
 			using operate_type = detail::query_op<connection>;
+			if (m_deferred_begin) {
+				// 事务的 BEGIN 与第一条语句一起发送
+				auto begin = std::move(m_deferred_begin);
+				m_deferred_begin.reset();
+				return async_query_group(query, { begin, query }, 1, 0, std::forward<CompletionToken>(token));
+			}
+			return boost::asio::async_compose<
+				CompletionToken,
+				void(boost::system::error_code, std::vector<std::shared_ptr<result>>)
+			>(
+				operate_type(*this, query, m_multiplexed),
+				std::forward<CompletionToken>(token), this->m_executor
+			);
+		}
+
+		/**
+		 * @brief 开始 COPY ... FROM STDIN(或 COPY TO STDOUT / START_REPLICATION)
+		 *
+		 * 成功时结果为 PGRES_COPY_IN(以 throw_if_copy_error 检查), 之后依次 async_copy_write 和 async_copy_end;
+		 * 结果为 PGRES_COPY_OUT / PGRES_COPY_BOTH 时以 async_copy_read 读取数据.
+		 * COPY 期间不能在该连接上执行其他查询, 多路复用连接不支持 COPY
+		 *
+		 * @param q COPY 语句
+		 * @param token void(boost::system::error_code, std::vector<std::shared_ptr<result>>)
+		 */
+		template <typename CompletionToken>
+		auto async_copy_start(std::shared_ptr<query> q, CompletionToken&& token) {
 			return boost::asio::async_compose<
 				CompletionToken,
 				void(boost::system::error_code, std::vector<std::shared_ptr<result>>)
 			>(
-				operate_type(*this, query),
-				std::forward<CompletionToken>(token), this->m_io
+				detail::copy_start_op<connection>(*this, std::move(q)),
+				token, this->m_executor
+			);
+		}
+
+		/**
+		 * @brief 写入 COPY 数据(文本格式为若干完整或不完整的行), 完成前 buffer 须保持有效
+		 *
+		 * @param token void(boost::system::error_code)
+		 */
+		template <typename CompletionToken>
+		auto async_copy_write(boost::asio::const_buffer buffer, CompletionToken&& token) {
+			return boost::asio::async_compose<
+				CompletionToken,
+				void(boost::system::error_code)
+			>(
+				detail::copy_data_op<connection>(*this, buffer),
+				token, this->m_executor
+			);
+		}
+
+		/**
+		 * @brief 读取一条 COPY 数据, 服务端结束 COPY 时为空
+		 *
+		 * 读操作在连接 strand 上进行; COPY BOTH 时可与 async_copy_write 并发(写同样转到 strand 上执行)
+		 *
+		 * @param token void(boost::system::error_code, std::string)
+		 */
+		template <typename CompletionToken>
+		auto async_copy_read(CompletionToken&& token) {
+			return boost::asio::async_compose<
+				CompletionToken,
+				void(boost::system::error_code, std::string)
+			>(
+				detail::copy_read_op<connection>(*this),
+				token, this->m_executor
+			);
+		}
+
+		/**
+		 * @brief 结束 COPY, 结果为 COPY 语句的最终结果(如 "COPY 1000" 或错误)
+		 *
+		 * @param token void(boost::system::error_code, std::vector<std::shared_ptr<result>>)
+		 */
+		template <typename CompletionToken>
+		auto async_copy_end(CompletionToken&& token) {
+			return boost::asio::async_compose<
+				CompletionToken,
+				void(boost::system::error_code, std::vector<std::shared_ptr<result>>)
+			>(
+				detail::copy_end_op<connection>(*this, std::nullopt),
+				token, this->m_executor
+			);
+		}
+
+		/**
+		 * @brief 中止 COPY, 服务端以 reason 报错并回滚本次 COPY
+		 */
+		template <typename CompletionToken>
+		auto async_copy_abort(std::string reason, CompletionToken&& token) {
+			return boost::asio::async_compose<
+				CompletionToken,
+				void(boost::system::error_code, std::vector<std::shared_ptr<result>>)
+			>(
+				detail::copy_end_op<connection>(*this, std::move(reason)),
+				token, this->m_executor
 			);
 		}
 
@@ -165,12 +407,76 @@ namespace pqcpp {
 			return this->async_query(q, use_awaitable);
 		}
 
+		/**
+		 * @brief 一次往返发送一组语句
+		 *
+		 * 以管道模式发送, 组内只有一个 sync; 执行成功的组首 hide_prefix 条和组尾 hide_suffix 条
+		 * 语句的结果不返回, 失败时保留. 管道模式使用扩展协议, 每条 query 只能包含一条 SQL 语句
+		 *
+		 * @param representative 用于统计/追踪的代表语句
+		 * @param token void(boost::system::error_code, std::vector<std::shared_ptr<pqcpp::result>>)
+		 */
+		template <typename CompletionToken>
+		auto async_query_group(
+			std::shared_ptr<query> representative,
+			std::vector<std::shared_ptr<query>> group,
+			std::size_t hide_prefix,
+			std::size_t hide_suffix,
+			CompletionToken&& token
+		) {
+			using operate_type = detail::query_op<connection>;
+			return boost::asio::async_compose<
+				CompletionToken,
+				void(boost::system::error_code, std::vector<std::shared_ptr<result>>)
+			>(
+				operate_type(*this, representative, std::move(group), hide_prefix, hide_suffix),
+				std::forward<CompletionToken>(token), this->m_executor
+			);
+		}
+
+		/**
+		 * @brief 执行事务中的最后一条语句并与 COMMIT 一起发送
+		 *
+		 * COMMIT 成功时不出现在结果中; 若仍有延迟的 BEGIN, 三者一次往返完成.
+		 * query 只能包含一条 SQL 语句(见 async_query_group)
+		 *
+		 * @param token void(boost::system::error_code, std::vector<std::shared_ptr<pqcpp::result>>)
+		 */
+		template <typename CompletionToken>
+		auto async_query_and_commit(std::shared_ptr<query> query, CompletionToken&& token) {
+			std::vector<std::shared_ptr<pqcpp::query>> group;
+			std::size_t hide_prefix = 0;
+			if (m_deferred_begin) {
+				group.push_back(std::move(m_deferred_begin));
+				m_deferred_begin.reset();
+				hide_prefix = 1;
+			}
+			group.push_back(query);
+			group.push_back(commit_query());
+			return async_query_group(query, std::move(group), hide_prefix, 1, std::forward<CompletionToken>(token));
+		}
+
+		/**
+		 * @brief 事务管道化
+		 *
+		 * 开启后 transaction() 不单独发送 BEGIN, 而是与事务内第一条语句一起发送;
+		 * 事务体未执行任何语句时不发送 BEGIN/END. 配合 async_query_and_commit 可让
+		 * 单语句事务一次往返完成. 与 BEGIN 一起发送的第一条语句走管道模式, 只能包含一条 SQL 语句,
+		 * 不能是以 ';' 分隔的多条语句
+		 */
+		void set_transaction_pipelining(bool enable) {
+			m_transaction_pipelining = enable;
+		}
+
+		template <typename CompletionToken>
+		auto async_start_transaction(transaction::level level, transaction::access access, CompletionToken&& token) {
+			PQCPP_LOG_TRACE("conn {} start transaction", this->id());
+			return async_query(begin_query(level, access), token);
+		}
+
 		template <typename CompletionToken>
 		auto async_start_transaction(transaction::level level, CompletionToken&& token) {
-			auto q = std::make_shared<query>(
-				fmt::format("BEGIN TRANSACTION ISOLATION LEVEL {};", transaction::to_string(level)));
-			logger()->trace("conn {} start transaction", this->id());
-			return async_query(q, token);
+			return async_start_transaction(level, transaction::READ_WRITE, token);
 		}
 
 		template <typename CompletionToken>
@@ -178,20 +484,45 @@ namespace pqcpp {
 			return async_start_transaction(transaction::SERIALIZABLE, token);
 		}
 
-				template <typename CompletionToken>
+		template <typename CompletionToken>
 		auto async_rollback_transaction(CompletionToken&& token) {
-			auto q = std::make_shared<query>("ROLLBACK;");
-			logger()->trace("conn {} rollback transaction", this->id());
+			static const auto q = std::make_shared<query>("ROLLBACK;");
+			PQCPP_LOG_TRACE("conn {} rollback transaction", this->id());
 			return async_query(q, token);
 		}
 
 		template <typename CompletionToken>
 		auto async_end_transaction(CompletionToken&& token) {
-			auto q = std::make_shared<query>("END;");
-			logger()->trace("conn {} end transaction", this->id());
+			static const auto q = std::make_shared<query>("END;");
+			PQCPP_LOG_TRACE("conn {} end transaction", this->id());
 			return async_query(q, token);
 		}
 
+		/**
+		 * @brief 批量事务: BEGIN、全部语句和 COMMIT 一次往返提交
+		 *
+		 * 返回各语句的结果, 失败的 BEGIN/COMMIT 结果也会包含在内, 全部 success() 即已提交;
+		 * 有语句失败时自动回滚. 不可在 transaction() 内调用.
+		 * 语句以管道模式(扩展协议)发送, 每条 query 只能包含一条 SQL 语句
+		 */
+		awaitable<std::vector<std::shared_ptr<result>>>
+		transaction_batch(std::vector<std::shared_ptr<query>> queries, transaction::level level = transaction::SERIALIZABLE) {
+			if (queries.empty()) {
+				co_return std::vector<std::shared_ptr<result>>{};
+			}
+			auto representative = queries.front();
+			std::vector<std::shared_ptr<query>> group;
+			group.reserve(queries.size() + 2);
+			group.push_back(begin_query(level));
+			group.insert(group.end(), queries.begin(), queries.end());
+			group.push_back(commit_query());
+			auto results = co_await async_query_group(representative, std::move(group), 1, 1, use_awaitable);
+			if (transaction_status() != PQTRANS_IDLE) {
+				co_await async_rollback_transaction(use_awaitable);
+			}
+			co_return results;
+		}
+
 		template <
 			typename F,
 			std::enable_if_t<
@@ -199,21 +530,21 @@ namespace pqcpp {
 			int
 			> = 1
 		>
-		auto transaction(transaction::level level, F && f) -> std::invoke_result_t<F> {
+		auto transaction(transaction::level level, transaction::access access, F && f) -> std::invoke_result_t<F> {
 			std::exception_ptr ex;
 			try {
-				co_await this->async_start_transaction(level, use_awaitable);
+				co_await this->begin_transaction(level, access);
 				co_await f();
 			}
 			catch (...) {
 				ex = std::current_exception();
 			}
 			if (ex) {
-				co_await this->async_rollback_transaction(use_awaitable);
+				co_await this->finish_transaction(true);
 				std::rethrow_exception(ex);
 			}
 			else {
-				co_await this->async_end_transaction(use_awaitable);
+				co_await this->finish_transaction(false);
 				co_return;
 			}
 		}
@@ -225,11 +556,11 @@ namespace pqcpp {
 			int
 			> = 1
 		>
-		auto transaction(transaction::level level, F && f) -> std::invoke_result_t<F> {
+		auto transaction(transaction::level level, transaction::access access, F && f) -> std::invoke_result_t<F> {
 			std::exception_ptr ex;
 			std::optional<concept::coroutine_function_result_t<F>> r;
 			try {
-				co_await this->async_start_transaction(level, use_awaitable);
+				co_await this->begin_transaction(level, access);
 				r = co_await f();
 			}
 			catch (...) {
@@ -237,15 +568,26 @@ namespace pqcpp {
 			}
 			
 			if (ex) {
-				co_await this->async_rollback_transaction(use_awaitable);
+				co_await this->finish_transaction(true);
 				std::rethrow_exception(ex);
 			}
 			else {
-				co_await this->async_end_transaction(use_awaitable);
+				co_await this->finish_transaction(false);
 				co_return *r;
 			}
 		}
 
+		template <
+			typename F,
+			std::enable_if_t<
+				concept::is_asio_coroutine_function_v<F>,
+				int
+			> = 1
+		>
+		auto transaction(transaction::level level, F && f) -> std::invoke_result_t<F> {
+			return this->transaction(level, transaction::READ_WRITE, std::forward<F>(f));
+		}
+
 		template <
 			typename F,
 			std::enable_if_t<
@@ -273,32 +615,120 @@ namespace pqcpp {
 		 *
 		 */
 		void disconnect() {
-			if (m_socket) {
-				m_socket->close();
-				m_socket.reset();
+			m_engine->close();
+		}
+
+		/**
+		 * @brief 请求服务端取消当前执行的查询(协议 CancelRequest), 线程安全
+		 *
+		 * 取消请求经独立连接在后台线程发送, 被取消的查询以 57014 错误结束, 连接仍可继续使用
+		 */
+		void cancel_query() {
+			boost::asio::post(m_strand, [self = shared_from_this()]() {
+				auto native_conn = self->get_native_conn();
+				if (!native_conn || self->m_engine->closed()) {
+					return;
+				}
+				auto cancel = PQgetCancel(native_conn);
+				if (!cancel) {
+					return;
+				}
+				boost::asio::post(detail::cancel_pool(), [cancel, id = self->id()]() {
+					char errbuf[256];
+					if (!PQcancel(cancel, errbuf, sizeof(errbuf))) {
+						PQCPP_LOG_WARN("conn {} cancel request failed: {}", id, errbuf);
+					}
+					PQfreeCancel(cancel);
+				});
+			});
+		}
+
+	private:
+		static const std::shared_ptr<query>& begin_query(
+			transaction::level level,
+			transaction::access access = transaction::READ_WRITE
+		) {
+			using namespace transaction;
+			static const std::shared_ptr<query> queries[][2] = {
+				{ std::make_shared<query>(begin_command(SERIALIZABLE, READ_WRITE)), std::make_shared<query>(begin_command(SERIALIZABLE, READ_ONLY)) },
+				{ std::make_shared<query>(begin_command(REPEATABLE_READ, READ_WRITE)), std::make_shared<query>(begin_command(REPEATABLE_READ, READ_ONLY)) },
+				{ std::make_shared<query>(begin_command(READ_COMMITTED, READ_WRITE)), std::make_shared<query>(begin_command(READ_COMMITTED, READ_ONLY)) },
+				{ std::make_shared<query>(begin_command(READ_UNCOMMITTED, READ_WRITE)), std::make_shared<query>(begin_command(READ_UNCOMMITTED, READ_ONLY)) }
+			};
+			// 校验参数
+			begin_command(level, access);
+			return queries[level][access];
+		}
+
+		static const std::shared_ptr<query>& commit_query() {
+			static const auto q = std::make_shared<query>("COMMIT;");
+			return q;
+		}
+
+		awaitable<void> begin_transaction(transaction::level level, transaction::access access) {
+			m_commit_failure.reset();
+			if (m_transaction_pipelining) {
+				m_deferred_begin = begin_query(level, access);
+				co_return;
 			}
-			if (m_native_conn) {
-				PQfinish(m_native_conn);
-				m_native_conn = nullptr;
+			co_await this->async_start_transaction(level, access, use_awaitable);
+		}
+
+		/**
+		 * @brief 结束 transaction() 开启的事务
+		 *
+		 * @param failed 事务体抛出异常
+		 */
+		awaitable<void> finish_transaction(bool failed) {
+			if (m_deferred_begin) {
+				// 事务体没有执行语句
+				m_deferred_begin.reset();
+				co_return;
+			}
+			auto commit_failure = std::move(m_commit_failure);
+			m_commit_failure.reset();
+			if (transaction_status() == PQTRANS_IDLE) {
+				// async_query_and_commit 已提交; 其 COMMIT 失败(如提交时的序列化失败)时事务同样已结束,
+				// 抛出 sql_error 以便调用者(及 transaction_with_retry)感知
+				if (commit_failure && !failed) {
+					commit_failure->throw_if_error();
+				}
+				co_return;
+			}
+			if (failed) {
+				co_await this->async_rollback_transaction(use_awaitable);
+			}
+			else {
+				// 提交时的序列化失败等错误抛出 sql_error
+				throw_if_error(co_await this->async_end_transaction(use_awaitable));
 			}
 		}
 
-	private:
-		connection(const std::string& conn_str, boost::asio::io_context& io)
-			:m_conn_str(conn_str), m_io(io), m_strand(io.get_executor())
+		connection(const std::string& conn_str, executor_type executor)
+			:m_conn_str(conn_str), m_executor(std::move(executor)), m_strand(m_executor),
+			m_engine(std::make_shared<detail::io_engine>(m_strand))
 		{
 			++total_;
-			logger()->trace("connection {} created, total {}", m_id, total_);
+			PQCPP_LOG_TRACE("connection {} created, total {}", m_id, total_);
 		}
 
 	private:
 		std::mutex m_mutex;
 		const std::size_t m_id = current_id++;
 		std::string m_conn_str;
-		boost::asio::io_context& m_io;
+		executor_type m_executor;
 		strand_type m_strand;
-		std::unique_ptr<socket_type> m_socket = nullptr;
-		::pg_conn* m_native_conn = nullptr;
+		std::shared_ptr<detail::io_engine> m_engine;
+		std::atomic_bool m_multiplexed{ false };
+		bool m_transaction_pipelining{ false };
+		// 延迟发送的 BEGIN
+		std::shared_ptr<query> m_deferred_begin;
+		// async_query_and_commit 中失败的 COMMIT 结果
+		std::shared_ptr<result> m_commit_failure;
+		query_observer m_query_observer;
+		std::atomic_size_t m_query_count{ 0 };
+		// reset_io_stats() 时的 m_query_count
+		std::atomic_size_t m_io_stats_query_base{ 0 };
 
 		inline static std::atomic_size_t current_id = 0;
 		inline static std::atomic_size_t total_ = 0;
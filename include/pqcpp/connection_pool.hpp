@@ -2,10 +2,19 @@
 
 #include <queue>
 #include <set>
+#include <vector>
 #include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
 #include <pqcpp/connection.hpp>
 #include <pqcpp/error.hpp>
 #include <pqcpp/logger.hpp>
+#include <pqcpp/concurrency_limit.hpp>
+#include <pqcpp/metrics.hpp>
+#include <pqcpp/type_registry.hpp>
+#include <pqcpp/detail/wait_queue.hpp>
 
 namespace pqcpp {
 
@@ -15,13 +24,163 @@ namespace pqcpp {
 			boost::asio::steady_timer timer(executor, duration);
 			co_await timer.async_wait(use_awaitable);
 		}
+
+		/**
+		 * @brief async_gather 的共享状态, 最后一条查询完成时调用 handler
+		 */
+		template <typename Handler>
+		struct gather_state {
+			using results_type = std::vector<std::vector<std::shared_ptr<result>>>;
+
+			gather_state(Handler&& handler, std::size_t count, boost::asio::any_io_executor executor)
+				:handler(std::move(handler)), executor(std::move(executor)), remaining(count), results(count)
+			{}
+
+			void complete(std::size_t index, const error_code& ec, std::vector<std::shared_ptr<result>> res) {
+				std::unique_lock lock(mutex);
+				if (ec && !first_ec) {
+					first_ec = ec;
+				}
+				results[index] = std::move(res);
+				if (--remaining == 0) {
+					lock.unlock();
+					auto ex = boost::asio::get_associated_executor(handler, executor);
+					boost::asio::post(ex, [h = std::move(handler), ec = first_ec, results = std::move(results)]() mutable {
+						h(ec, std::move(results));
+					});
+				}
+			}
+
+			std::mutex mutex;
+			Handler handler;
+			boost::asio::any_io_executor executor;
+			std::size_t remaining;
+			results_type results;
+			error_code first_ec;
+		};
+
+		/**
+		 * @brief 连接池指标, 以 pool 标签区分不同连接池
+		 */
+		struct pool_metrics {
+			metrics::histogram& acquire_wait;
+			metrics::gauge& in_use;
+			metrics::gauge& idle;
+			metrics::gauge& pending;
+			metrics::gauge& connections;
+			metrics::histogram& connect_latency;
+			metrics::counter& connect_failures;
+			metrics::counter& queries;
+			metrics::counter& query_failures;
+			metrics::histogram& query_latency;
+			metrics::histogram& queries_per_connection;
+			metrics::counter& bytes_sent;
+			metrics::counter& result_bytes;
+
+			pool_metrics(metrics::registry& reg, const std::string& pool)
+				:acquire_wait(reg.make_histogram("pqcpp_pool_acquire_wait_seconds", "Time spent waiting for a pooled connection", { { "pool", pool } })),
+				in_use(reg.make_gauge("pqcpp_pool_connections_in_use", "Connections checked out of the pool", { { "pool", pool } })),
+				idle(reg.make_gauge("pqcpp_pool_connections_idle", "Idle connections kept in the pool", { { "pool", pool } })),
+				pending(reg.make_gauge("pqcpp_pool_pending_requests", "get() calls waiting for a connection", { { "pool", pool } })),
+				connections(reg.make_gauge("pqcpp_pool_connections", "Connections owned by the pool, including ones being established", { { "pool", pool } })),
+				connect_latency(reg.make_histogram("pqcpp_connect_seconds", "Connection establishment latency", { { "pool", pool } })),
+				connect_failures(reg.make_counter("pqcpp_connect_failures_total", "Failed connection attempts", { { "pool", pool } })),
+				queries(reg.make_counter("pqcpp_queries_total", "Queries completed", { { "pool", pool } })),
+				query_failures(reg.make_counter("pqcpp_query_failures_total", "Queries aborted by network or protocol errors", { { "pool", pool } })),
+				query_latency(reg.make_histogram("pqcpp_query_seconds", "Query latency from send to last result", { { "pool", pool } })),
+				queries_per_connection(reg.make_histogram(
+					"pqcpp_connection_queries", "Queries served by a connection over its lifetime", { { "pool", pool } },
+					{ 1, 10, 100, 1000, 10000, 100000, 1000000 }
+				)),
+				bytes_sent(reg.make_counter("pqcpp_bytes_sent_total", "Query text and parameter bytes sent", { { "pool", pool } })),
+				result_bytes(reg.make_counter("pqcpp_result_memory_bytes_total", "Memory allocated for query results (PQresultMemorySize)", { { "pool", pool } }))
+			{}
+
+			void on_query(const query_stats& stats) {
+				if (stats.success) {
+					queries.inc();
+				}
+				else {
+					query_failures.inc();
+				}
+				query_latency.observe(std::chrono::duration<double>(stats.latency).count());
+				bytes_sent.inc(stats.bytes_sent);
+				result_bytes.inc(stats.bytes_received);
+			}
+		};
 	}
 
     struct connection_pool_option {
         int min_size = 3;
         int max_size = 10;
+
+		/**
+		 * @brief 新连接使用的 executor, 为空时使用连接池的 executor
+		 *
+		 * 例如 io_context_pool::selector(), 把连接分散到多个 io_context
+		 */
+		std::function<boost::asio::any_io_executor()> connection_executor;
+
+		// 连接池名称, 作为指标的 pool 标签
+		std::string name = "default";
+		/**
+		 * @brief 指标注册表, 为空(默认)时不采集
+		 *
+		 * 如 &metrics::registry::global(); 同一注册表下的连接池须使用不同的 name
+		 */
+		metrics::registry* metrics_registry = nullptr;
+
+		/**
+		 * @brief 自适应保温连接数
+		 *
+		 * 开启后池内保留的连接数(warm size)在 [min_size, max_size] 之间,
+		 * 根据利用率、获取等待时间和建连耗时带滞回地调整; 关闭时固定为 min_size
+		 */
+		bool adaptive = false;
+		// 调整周期
+		std::chrono::milliseconds adjust_interval{ 1000 };
+		// 周期内峰值利用率(占用+等待)/warm 达到该值时扩大
+		double grow_utilization = 0.8;
+		// 周期内峰值利用率低于该值时计入收缩
+		double shrink_utilization = 0.4;
+		// 获取连接平均等待时间超过该值时扩大
+		std::chrono::microseconds grow_wait_threshold{ 2000 };
+		// 连续低利用率周期数达到该值才收缩一步
+		int shrink_after = 10;
+		// 等待时间、建连耗时 EWMA 平滑系数
+		double ewma_alpha = 0.2;
+
+		/**
+		 * @brief 自适应并发限制
+		 *
+		 * 设置后同时借出的连接数不超过按查询延迟估算的 limit, 超出的 get() 排队等待
+		 */
+		std::optional<concurrency_limit_option> concurrency_limit;
+
+		/**
+		 * @brief 等待者调度
+		 *
+		 * priority_weights[i] 为优先级 i 的权重(超出取最后一个), 仅 weighted_fair 使用;
+		 * tenant_weights 为同一优先级内各租户权重, 默认 1
+		 */
+		waiter_scheduling scheduling = waiter_scheduling::weighted_fair;
+		std::vector<double> priority_weights{ 16, 4, 1 };
+		std::map<std::string, double> tenant_weights;
+
+		// 启动后即借出连接加载类型注册表, 否则在首次 types() 时加载
+		bool load_types = false;
     };
 
+	/**
+	 * @brief 获取连接参数
+	 */
+	struct get_option {
+		// 优先级, 0 最高
+		int priority = 0;
+		// 租户, 同一优先级内按租户公平排队
+		std::string tenant;
+	};
+
     class connection_pool: public std::enable_shared_from_this<connection_pool> {
         friend class connection_holder;
 
@@ -31,21 +190,26 @@ namespace pqcpp {
 			conn_ptr_deleter(std::weak_ptr<connection_pool> pool)
 				:_pool(pool)
 			{
-				logger()->trace("create conn_ptr_deleter");
+				PQCPP_LOG_TRACE("create conn_ptr_deleter");
 			}
 
 			void operator()(connection* conn) {
-				logger()->trace("call conn_ptr_deleter");
+				PQCPP_LOG_TRACE("call conn_ptr_deleter");
 				auto pool = _pool.lock();
-				if (pool && conn->is_ready()) {
-					logger()->trace("conn {} is ready, return conn to pool", conn->id());
-					pool->on_conn_ready(conn_ptr_inner(conn));
+				// 放弃等待的操作仍在进行时连接不可复用, 析构连接使其以 operation_aborted 结束
+				bool reusable = conn->is_ready() && conn->transaction_status() != PQTRANS_ACTIVE;
+				if (pool && pool->m_metrics && !reusable) {
+					pool->m_metrics->queries_per_connection.observe(static_cast<double>(conn->query_count()));
+				}
+				if (pool && reusable) {
+					PQCPP_LOG_TRACE("conn {} is ready, return conn to pool", conn->id());
+					pool->on_conn_released(conn_ptr_inner(conn));
 				}
 				else {
-					logger()->warn("connection not ready, delete conn and notify pool");
+					PQCPP_LOG_WARN("connection not ready, delete conn and notify pool");
 					delete conn;
 					if (pool) {
-						pool->on_conn_lost();
+						pool->on_conn_released(nullptr);
 					}
 				}
 			}
@@ -54,8 +218,14 @@ namespace pqcpp {
 		friend struct conn_ptr_deleter;
 
 		using conn_ptr_inner = std::unique_ptr<connection>;
+		using clock_type = std::chrono::steady_clock;
 
 		auto make_conn_ptr(conn_ptr_inner&& conn) {
+			++m_in_use;
+			if (m_limiter) {
+				m_limiter->on_acquire();
+			}
+			note_demand();
 			return conn_ptr(
 				conn.release(),
 				conn_ptr_deleter(weak_from_this())
@@ -64,17 +234,44 @@ namespace pqcpp {
     public:
         using conn_ptr = std::shared_ptr<connection>;
         using get_handler = std::function<void(error_code, conn_ptr)>;
+		using executor_type = boost::asio::any_io_executor;
+
+		/**
+		 * @brief 创建连接池
+		 *
+		 * @param executor 连接池内部调度所在的 executor, 连接默认也在其上运行
+		 */
+		static std::shared_ptr<connection_pool> make(executor_type executor, const std::string& conn_str, const connection_pool_option& option) {
+			std::shared_ptr<connection_pool> pool(new connection_pool(std::move(executor), conn_str, option));
+			pool->init();
+			return pool;
+		}
+
+		static std::shared_ptr<connection_pool> make(executor_type executor, const connection_options& opts, const connection_pool_option& option) {
+			return make(std::move(executor), opts.get_conn_str(), option);
+		}
+
+		static std::shared_ptr<connection_pool> make(executor_type executor, const std::string& conn_str, int min = 3, int max = 10) {
+			connection_pool_option option;
+			option.min_size = min;
+			option.max_size = max;
+			return make(std::move(executor), conn_str, option);
+		}
 
         static std::shared_ptr<connection_pool> make(boost::asio::io_context& io, const std::string &conn_str, int min = 3, int max = 10) {
-            std::shared_ptr<connection_pool> pool(new connection_pool(io, conn_str, min, max));
-            pool->init();
-            return pool;
+            return make(io.get_executor(), conn_str, min, max);
         }
 
 		static std::shared_ptr<connection_pool> make(boost::asio::io_context& io, const connection_options& opts, int min = 3, int max = 10) {
-			std::shared_ptr<connection_pool> pool(new connection_pool(io, opts, min, max));
-			pool->init();
-			return pool;
+			return make(io, opts.get_conn_str(), min, max);
+		}
+
+		static std::shared_ptr<connection_pool> make(boost::asio::io_context& io, const std::string& conn_str, const connection_pool_option& option) {
+			return make(io.get_executor(), conn_str, option);
+		}
+
+		static std::shared_ptr<connection_pool> make(boost::asio::io_context& io, const connection_options& opts, const connection_pool_option& option) {
+			return make(io, opts.get_conn_str(), option);
 		}
 
         connection_pool(const connection_pool&) = delete;
@@ -84,30 +281,44 @@ namespace pqcpp {
 
         template <typename CompletionToken>
         auto get(CompletionToken token) {
+			return get(get_option{}, std::move(token));
+		}
+
+		/**
+		 * @brief 按优先级/租户获取连接
+		 *
+		 * @param opt
+		 * @param token void(boost::system::error_code, conn_ptr)
+		 */
+		template <typename CompletionToken>
+		auto get(get_option opt, CompletionToken token) {
 			return boost::asio::async_initiate<
 				CompletionToken,
 				void(boost::system::error_code, conn_ptr)
 			>(
-				[this](auto handler) mutable {
+				[this, opt = std::move(opt)](auto handler) mutable {
 					boost::asio::post(m_strand, [
-						handler = std::move(handler), this, self = shared_from_this()
+						handler = std::move(handler), opt = std::move(opt), this, self = shared_from_this()
 					]() mutable {
-						if (!m_conns.empty()) {
+						if (!m_conns.empty() && admit()) {
 							auto it = m_conns.begin();
 							auto conn = make_conn_ptr(std::move(it->second));
 							m_conns.erase(it);
+							record_wait(clock_type::duration::zero());
+							update_gauges();
 							handler(error_code{}, conn);
 						}
 						else {
-							this->enqueue_get_handler(std::move(handler));
-							if (
+							this->enqueue_get_handler(std::move(handler), opt);
+							if (admit() && (
 								(m_filling && m_pendings.size() <= static_cast<size_t>(m_max - m_min))
 								|| m_conn_count < m_max
-							) {
+							)) {
 								co_spawn(m_strand,[this, self = shared_from_this()]() {
 									return create_conn();
 								}, detached);
 							}
+							update_gauges();
 						}
 					});
 				},
@@ -115,29 +326,137 @@ namespace pqcpp {
 			);
         }
 
-		auto& get_executor() {
-			return m_io;
+		/**
+		 * @brief 在各自借出的连接上并发执行多条独立查询
+		 *
+		 * 全部完成后按原顺序返回各查询的结果, ec 为第一个失败的查询/获取连接错误,
+		 * 成功部分的结果仍然返回; 并发度受连接池大小限制
+		 *
+		 * @param queries
+		 * @param token void(boost::system::error_code, std::vector<std::vector<std::shared_ptr<result>>>)
+		 */
+		template <typename CompletionToken>
+		auto async_gather(std::vector<std::shared_ptr<query>> queries, CompletionToken&& token) {
+			using results_type = std::vector<std::vector<std::shared_ptr<result>>>;
+			return boost::asio::async_initiate<
+				CompletionToken,
+				void(boost::system::error_code, results_type)
+			>(
+				[self = shared_from_this(), queries = std::move(queries)](auto handler) mutable {
+					using state_type = detail::gather_state<decltype(handler)>;
+					if (queries.empty()) {
+						auto ex = boost::asio::get_associated_executor(handler, self->m_executor);
+						boost::asio::post(ex, [handler = std::move(handler)]() mutable {
+							handler(error_code{}, results_type{});
+						});
+						return;
+					}
+					auto state = std::make_shared<state_type>(std::move(handler), queries.size(), self->m_executor);
+					for (std::size_t i = 0; i < queries.size(); ++i) {
+						self->get([state, i, q = queries[i]](error_code ec, conn_ptr conn) {
+							if (ec) {
+								state->complete(i, ec, {});
+								return;
+							}
+							auto on_query = [state, i, conn](error_code ec, std::vector<std::shared_ptr<result>> results) {
+								state->complete(i, ec, std::move(results));
+							};
+							conn->async_query(q, on_query);
+						});
+					}
+				},
+				token
+			);
+		}
+
+		/**
+		 * @brief 连接池所在的 executor
+		 *
+		 * 此前返回 io_context&, 需要 io_context 本身时由调用方保存
+		 */
+		const executor_type& get_executor() const {
+			return m_executor;
 		}
 
-    private:
-        connection_pool(boost::asio::io_context& io, const std::string& conn_str, int min, int max)
-            :m_io(io), m_conn_str(conn_str), m_min(min), m_max(max)
-        {
-			m_fill_timer.expires_at(std::chrono::steady_clock::time_point::max());
+		/**
+		 * @brief 兼容原 get_executor() 的 io_context&, 连接池不在 io_context 上时抛出 std::logic_error
+		 */
+		boost::asio::io_context& get_io_context() const {
+			if (auto ex = m_executor.target<boost::asio::io_context::executor_type>()) {
+				return ex->context();
+			}
+			throw std::logic_error("connection_pool is not running on an io_context");
 		}
 
-		connection_pool(boost::asio::io_context& io, const connection_options& opts, int min, int max)
-			:m_io(io), m_conn_str(opts.get_conn_str()), m_min(min), m_max(max)
-		{
+		const std::string& get_conn_str() const {
+			return m_conn_str;
+		}
+
+		const connection_pool_option& option() const {
+			return m_option;
+		}
+
+		/**
+		 * @brief 类型注册表, 首次调用时借出连接加载并缓存; 并发的首次调用可能各自加载一次
+		 */
+		awaitable<std::shared_ptr<const type_registry>> types() {
+			if (auto cached = cached_types()) {
+				co_return cached;
+			}
+			co_return co_await reload_types();
+		}
+
+		/**
+		 * @brief 重新加载类型注册表, 如 DDL 新增或修改类型后
+		 */
+		awaitable<std::shared_ptr<const type_registry>> reload_types() {
+			auto self = shared_from_this();
+			auto conn = co_await get(use_awaitable);
+			std::shared_ptr<const type_registry> registry = co_await type_registry::load(conn);
+			{
+				std::unique_lock lock(m_types_mutex);
+				m_types = registry;
+			}
+			co_return registry;
+		}
+
+		/**
+		 * @brief 已缓存的类型注册表, 尚未加载时为空
+		 */
+		std::shared_ptr<const type_registry> cached_types() const {
+			std::unique_lock lock(m_types_mutex);
+			return m_types;
+		}
+
+		/**
+		 * @brief 当前并发限制, 未开启时为 max_size
+		 */
+		int concurrency_limit() const {
+			return m_limiter ? std::min(m_limiter->limit(), m_max) : m_max;
+		}
+
+    private:
+        connection_pool(executor_type executor, const std::string& conn_str, const connection_pool_option& option)
+            :m_conn_str(conn_str),
+			m_pendings(option.scheduling, option.priority_weights, option.tenant_weights),
+			m_executor(std::move(executor)), m_min(option.min_size), m_max(option.max_size),
+			m_option(option), m_warm(option.min_size)
+        {
 			m_fill_timer.expires_at(std::chrono::steady_clock::time_point::max());
+			if (option.concurrency_limit) {
+				m_limiter = std::make_shared<concurrency_limiter>(*option.concurrency_limit);
+			}
+			if (option.metrics_registry) {
+				m_metrics = std::make_shared<detail::pool_metrics>(*option.metrics_registry, option.name);
+			}
 		}
 
 		void start_fill_conns() {
 			co_spawn(m_strand, [this, self = shared_from_this()]() -> awaitable<void> {
 				while (true) {
-					logger()->trace("start fill connection, m_conn_count={}, m_min={}", m_conn_count, m_min);
+					PQCPP_LOG_TRACE("start fill connection, m_conn_count={}, warm={}", m_conn_count, warm_size());
 					try {
-						while (m_conn_count < m_min) {
+						while (m_conn_count < warm_size()) {
 							co_await create_conn();
 						}
 						boost::system::error_code ec;
@@ -145,19 +464,136 @@ namespace pqcpp {
 						continue;
 					}
 					catch (const std::exception& ex) {
-						logger()->error("fill connection error: {}", ex.what());
+						PQCPP_LOG_ERROR("fill connection error: {}", ex.what());
 					}
 					co_await detail::delay(m_strand, std::chrono::seconds(3));
 				}
 			}, detached);
 		}
 
+		/**
+		 * @brief 周期性调整保温连接数, 池销毁后自动退出
+		 */
+		void start_adjust_warm() {
+			co_spawn(m_strand, [weak = weak_from_this(), strand = m_strand, interval = m_option.adjust_interval]() -> awaitable<void> {
+				while (true) {
+					co_await detail::delay(strand, interval);
+					auto self = weak.lock();
+					if (!self) {
+						co_return;
+					}
+					self->adjust_warm();
+				}
+			}, detached);
+		}
+
         void init() {
 			start_fill_conns();
+			if (m_option.adaptive) {
+				start_adjust_warm();
+			}
+			if (m_option.load_types) {
+				co_spawn(m_executor, [self = shared_from_this()]() -> awaitable<void> {
+					try {
+						co_await self->reload_types();
+					}
+					catch (const std::exception& ex) {
+						PQCPP_LOG_ERROR("load type registry error: {}", ex.what());
+					}
+				}, detached);
+			}
         }
 
+		/**
+		 * @brief 当前保温连接数
+		 */
+		int warm_size() const {
+			return m_option.adaptive ? m_warm : m_min;
+		}
+
+		/**
+		 * @brief 是否允许再借出一个连接
+		 */
+		bool admit() const {
+			return !m_limiter || m_in_use < m_limiter->limit();
+		}
+
+		void note_demand() {
+			m_peak_demand = std::max(m_peak_demand, m_in_use + static_cast<int>(m_pendings.size()));
+		}
+
+		void update_gauges() {
+			if (m_metrics) {
+				m_metrics->in_use.set(m_in_use);
+				m_metrics->idle.set(static_cast<std::int64_t>(m_conns.size()));
+				m_metrics->pending.set(static_cast<std::int64_t>(m_pendings.size()));
+				m_metrics->connections.set(m_conn_count);
+			}
+		}
+
+		void observe_closed(const connection& conn) {
+			if (m_metrics) {
+				m_metrics->queries_per_connection.observe(static_cast<double>(conn.query_count()));
+			}
+		}
+
+		void record_wait(clock_type::duration wait) {
+			if (m_metrics) {
+				m_metrics->acquire_wait.observe(std::chrono::duration<double>(wait).count());
+			}
+			auto us = std::chrono::duration<double, std::micro>(wait).count();
+			m_wait_ewma_us += m_option.ewma_alpha * (us - m_wait_ewma_us);
+		}
+
+		void record_connect(clock_type::duration elapsed) {
+			auto us = std::chrono::duration<double, std::micro>(elapsed).count();
+			m_connect_ewma_us = m_connect_ewma_us == 0
+				? us
+				: m_connect_ewma_us + m_option.ewma_alpha * (us - m_connect_ewma_us);
+		}
+
+		void adjust_warm() {
+			int demand = m_peak_demand;
+			m_peak_demand = m_in_use + static_cast<int>(m_pendings.size());
+			double utilization = static_cast<double>(demand) / std::max(m_warm, 1);
+			double wait_threshold = std::chrono::duration<double, std::micro>(m_option.grow_wait_threshold).count();
+			bool waiting = demand > 0 && m_wait_ewma_us > wait_threshold;
+			if (utilization >= m_option.grow_utilization || waiting) {
+				// 建连比可容忍的等待更贵时一次多扩一些, 避免突发期间反复排队建连
+				int step = m_connect_ewma_us > wait_threshold ? std::max(2, m_warm / 2) : 1;
+				m_warm = std::min(m_max, std::max(demand, m_warm + step));
+				m_low_streak = 0;
+				if (m_conn_count < m_warm) {
+					m_fill_timer.cancel_one();
+				}
+			}
+			else if (utilization < m_option.shrink_utilization) {
+				if (++m_low_streak >= m_option.shrink_after) {
+					m_warm = std::max(m_min, std::max(demand, m_warm - 1));
+					m_low_streak = 0;
+					while (m_conns.size() > static_cast<size_t>(m_warm)) {
+						auto it = m_conns.begin();
+						PQCPP_LOG_TRACE("shrink warm set, drop conn {}", it->first);
+						observe_closed(*it->second);
+						m_conns.erase(it);
+						drop_conn();
+					}
+				}
+			}
+			else {
+				m_low_streak = 0;
+			}
+			if (m_wait_ewma_us > 0 && demand == 0) {
+				m_wait_ewma_us *= 1 - m_option.ewma_alpha;
+			}
+			PQCPP_LOG_TRACE(
+				"adjust warm size {}, demand {}, wait ewma {:.0f}us, connect ewma {:.0f}us",
+				m_warm, demand, m_wait_ewma_us, m_connect_ewma_us
+			);
+		}
+
 		template <typename Handler>
-		void enqueue_get_handler(Handler&& handler) {
+		void enqueue_get_handler(Handler&& handler, const get_option& opt) {
 			struct completion {
 				std::shared_ptr<std::decay_t<Handler>> ptr_;
 				completion(Handler&& h)
@@ -167,54 +603,105 @@ namespace pqcpp {
 					(*ptr_)(ec, conn);
 				}
 			};
-			logger()->trace("enqueue_get_handler");
-			this->m_pendings.emplace(completion(std::forward<Handler>(handler)));
+			PQCPP_LOG_TRACE("enqueue_get_handler");
+			this->m_pendings.push(
+				{ completion(std::forward<Handler>(handler)), clock_type::now() },
+				opt.priority,
+				opt.tenant
+			);
+			note_demand();
 		}
 
 		void on_conn_ready(conn_ptr_inner conn) {
 			boost::asio::post(m_strand, [
 				conn = std::move(conn), this, self = shared_from_this()
 			]() mutable {
-				auto id = conn->id();
-				if (!m_pendings.empty()) {
-					auto handler = std::move(m_pendings.front());
-					m_pendings.pop();
-					handler({}, make_conn_ptr(std::move(conn)));
+				dispatch_conn(std::move(conn));
+			});
+		}
+
+		/**
+		 * @brief 用户归还连接, conn 为空表示连接已失效
+		 */
+		void on_conn_released(conn_ptr_inner conn) {
+			boost::asio::post(m_strand, [
+				conn = std::move(conn), this, self = shared_from_this()
+			]() mutable {
+				--m_in_use;
+				if (m_limiter) {
+					m_limiter->on_release();
+				}
+				if (conn) {
+					dispatch_conn(std::move(conn));
 				}
 				else {
-				   if (m_conns.size() < static_cast<size_t>(m_min)) {
-					   m_conns.insert(std::make_pair(conn->id(), std::move(conn)));
-				   }
-				   else {
-					   logger()->trace("pool full, drop conn {}", conn->id());
-					   delete conn.release();
-					   on_conn_lost();
-				   }
+					drop_conn();
 				}
-				logger()->trace(
-					"conn ready {}, remain {}, in pool {}",
-					id,
-					m_conn_count,
-					m_conns.size()
-				);
+				// limit 上调后, 空闲连接可继续分给等待者
+				while (!m_pendings.empty() && !m_conns.empty() && admit()) {
+					auto it = m_conns.begin();
+					auto idle = std::move(it->second);
+					m_conns.erase(it);
+					serve_pending(std::move(idle));
+				}
+				update_gauges();
 			});
 		}
 
+		void dispatch_conn(conn_ptr_inner conn) {
+			[[maybe_unused]] auto id = conn->id();
+			if (!m_pendings.empty() && admit()) {
+				serve_pending(std::move(conn));
+			}
+			else if (m_conns.size() < static_cast<size_t>(warm_size())) {
+				// 无等待者, 或受并发限制时留给后续等待者
+				m_conns.insert(std::make_pair(conn->id(), std::move(conn)));
+			}
+			else {
+				PQCPP_LOG_TRACE("pool full, drop conn {}", conn->id());
+				observe_closed(*conn);
+				delete conn.release();
+				drop_conn();
+			}
+			update_gauges();
+			PQCPP_LOG_TRACE(
+				"conn ready {}, remain {}, in pool {}",
+				id,
+				m_conn_count,
+				m_conns.size()
+			);
+		}
+
+		void serve_pending(conn_ptr_inner conn) {
+			auto pending = m_pendings.pop();
+			record_wait(clock_type::now() - pending.enqueued);
+			pending.handler({}, make_conn_ptr(std::move(conn)));
+		}
+
 		void on_conn_lost() {
 			boost::asio::post(m_strand, [
 				this, self = shared_from_this()
 			]() mutable {
-				if (--m_conn_count < m_min) {
-					m_fill_timer.cancel_one();
-				}
-				logger()->trace(
-					"conn lost, remain {}, in pool {}",
-					m_conn_count,
-					m_conns.size()
-				);
+				drop_conn();
 			});
 		}
 
+		void drop_conn() {
+			if (--m_conn_count < warm_size()) {
+				m_fill_timer.cancel_one();
+			}
+			update_gauges();
+			PQCPP_LOG_TRACE(
+				"conn lost, remain {}, in pool {}",
+				m_conn_count,
+				m_conns.size()
+			);
+		}
+
+		executor_type next_conn_executor() {
+			return m_option.connection_executor ? m_option.connection_executor() : m_executor;
+		}
+
         awaitable<void> create_conn() {
 			if (m_conn_count >= m_max) {
 				co_return;
@@ -222,36 +709,77 @@ namespace pqcpp {
 			else {
 				++m_conn_count;
 			}
-			logger()->trace("start create connection");
+			PQCPP_LOG_TRACE("start create connection");
 			try {
 				conn_ptr_inner conn(
-					new connection(m_conn_str, m_io)
+					new connection(m_conn_str, next_conn_executor())
 				);
+				if (m_limiter || m_metrics) {
+					conn->set_query_observer([limiter = m_limiter, metrics = m_metrics](const query_stats& stats) {
+						if (limiter) {
+							limiter->on_sample(stats.latency, stats.success);
+						}
+						if (metrics) {
+							metrics->on_query(stats);
+						}
+					});
+				}
+				auto start = clock_type::now();
 				co_await conn->async_connect(use_awaitable);
+				record_connect(clock_type::now() - start);
+				if (m_metrics) {
+					m_metrics->connect_latency.observe(std::chrono::duration<double>(clock_type::now() - start).count());
+				}
 				on_conn_ready(std::move(conn));
 			}
 			catch (const error_code& ec) {
-				logger()->error("create connection error: {}", ec);
+				if (m_metrics) {
+					m_metrics->connect_failures.inc();
+				}
+				PQCPP_LOG_ERROR("create connection error: {}", ec.message());
 				on_conn_lost();
 				throw;
 			}
 			catch (const std::exception& ex) {
-				logger()->error("create connection error: {}", ex.what());
+				if (m_metrics) {
+					m_metrics->connect_failures.inc();
+				}
+				PQCPP_LOG_ERROR("create connection error: {}", ex.what());
 				on_conn_lost();
 				throw;
 			}
         }
 
     private:
+		struct pending_get {
+			get_handler handler;
+			clock_type::time_point enqueued;
+		};
+
         std::string m_conn_str;
 		int m_conn_count{ 0 };
         std::map<size_t, conn_ptr_inner> m_conns;
-        std::queue<get_handler> m_pendings;
-        boost::asio::io_context& m_io;
-		boost::asio::strand<boost::asio::io_context::executor_type> m_strand{ m_io.get_executor() };
+        detail::wait_queue<pending_get> m_pendings;
+        executor_type m_executor;
+		boost::asio::strand<executor_type> m_strand{ m_executor };
 		boost::asio::steady_timer m_fill_timer{ m_strand };
         int m_min;
         int m_max;
         bool m_filling{false};
+
+		connection_pool_option m_option;
+		// 已借出连接数
+		int m_in_use{ 0 };
+		// 自适应保温连接数
+		int m_warm;
+		// 本周期峰值需求(借出+等待)
+		int m_peak_demand{ 0 };
+		int m_low_streak{ 0 };
+		double m_wait_ewma_us{ 0 };
+		double m_connect_ewma_us{ 0 };
+		std::shared_ptr<concurrency_limiter> m_limiter;
+		std::shared_ptr<detail::pool_metrics> m_metrics;
+		mutable std::mutex m_types_mutex;
+		std::shared_ptr<const type_registry> m_types;
     };
 };
\ No newline at end of file
@@ -0,0 +1,409 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+#include <functional>
+#include <pqcpp/connection_pool.hpp>
+#include <pqcpp/converter.hpp>
+#include <pqcpp/result.hpp>
+#include <pqcpp/detail/fan_out.hpp>
+#include <pqcpp/detail/waiter_list.hpp>
+
+namespace pqcpp {
+
+	namespace detail {
+		/**
+		 * @brief 按 field_converter 转换, 字符串字面量等可转为 string_view 的类型按文本处理
+		 */
+		template <typename T>
+		field to_field(const T& value) {
+			if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+				return field_converter<std::string_view>::to_field(value);
+			}
+			else {
+				return field_converter<std::decay_t<T>>::to_field(value);
+			}
+		}
+	}
+
+	/**
+	 * @brief 以 COPY 文本格式追加一个字段(不含分隔符)
+	 */
+	inline void append_copy_field(std::string& out, const field& f) {
+		if (f.null()) {
+			out += "\\N";
+			return;
+		}
+		const char* data = f.data();
+		auto size = static_cast<std::size_t>(f.size());
+		if (f.format == binary_format) {
+			// bytea 十六进制格式, 反斜杠本身需转义
+			static const char digits[] = "0123456789abcdef";
+			out += "\\\\x";
+			for (std::size_t i = 0; i < size; ++i) {
+				auto c = static_cast<unsigned char>(data[i]);
+				out += digits[c >> 4];
+				out += digits[c & 0xf];
+			}
+			return;
+		}
+		for (std::size_t i = 0; i < size; ++i) {
+			switch (data[i]) {
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default: out += data[i];
+			}
+		}
+	}
+
+	/**
+	 * @brief 以 COPY 文本格式追加一行, 字段按 field_converter 转换, std::nullopt 为 NULL
+	 */
+	template <typename ...Args>
+	void append_copy_row(std::string& out, const Args& ...args) {
+		bool first = true;
+		auto append = [&out, &first](const field& f) {
+			if (!first) {
+				out += '\t';
+			}
+			first = false;
+			append_copy_field(out, f);
+		};
+		(append(detail::to_field(args)), ...);
+		out += '\n';
+	}
+
+	struct bulk_loader_option {
+		// 并发 COPY 流(连接)数, 不超过连接池当前的并发限制(concurrency_limit(), 未开启自适应限制时为 max_size)
+		std::size_t streams = 4;
+		// 单次写入的块大小, 行按块轮流分配到各流
+		std::size_t chunk_bytes = 256 * 1024;
+		// 每个流已排队未写出的数据上限, 超出时 add() 等待
+		std::size_t buffer_bytes = 4 * 1024 * 1024;
+	};
+
+	struct bulk_load_stats {
+		// 已写出(交给内核)的行数/字节数
+		std::size_t rows{ 0 };
+		std::size_t bytes{ 0 };
+		std::chrono::steady_clock::duration elapsed{};
+
+		double rows_per_second() const {
+			auto s = std::chrono::duration<double>(elapsed).count();
+			return s > 0 ? rows / s : 0;
+		}
+
+		double bytes_per_second() const {
+			auto s = std::chrono::duration<double>(elapsed).count();
+			return s > 0 ? bytes / s : 0;
+		}
+	};
+
+	/**
+	 * @brief 并行 COPY 装载
+	 *
+	 * 从连接池借出 N 个连接, 各自执行同一条 COPY ... FROM STDIN. 生产者 add() 的行
+	 * 编码为 COPY 文本格式后按块轮流分配到各流, 每个流有独立的有界缓冲区, 写满时 add() 等待.
+	 * 各流是独立事务, 某个流失败不影响其他流已提交的数据
+	 *
+	 * @code
+	 * auto loader = co_await bulk_loader::open(pool, "COPY events (id, payload) FROM STDIN");
+	 * for (...) {
+	 *     co_await loader->add(id, payload);
+	 * }
+	 * auto stats = co_await loader->finish();
+	 * @endcode
+	 */
+	class bulk_loader {
+		using clock_type = std::chrono::steady_clock;
+
+		struct chunk {
+			std::string data;
+			std::size_t rows{ 0 };
+		};
+
+		struct counters {
+			std::atomic_size_t rows{ 0 };
+			std::atomic_size_t bytes{ 0 };
+		};
+
+		struct stream {
+			std::shared_ptr<connection> conn;
+			std::shared_ptr<counters> totals;
+			std::size_t buffer_bytes{ 0 };
+			std::mutex mutex;
+			std::deque<chunk> chunks;
+			std::size_t queued_bytes{ 0 };
+			// 生产者已结束, 写完剩余数据后结束 COPY
+			bool closing{ false };
+			// 放弃剩余数据并中止 COPY
+			bool aborting{ false };
+			bool done{ false };
+			std::exception_ptr error;
+			detail::waiter_list writer_waiters;
+			detail::waiter_list producer_waiters;
+		};
+
+	public:
+		static awaitable<std::shared_ptr<bulk_loader>> open(
+			std::shared_ptr<connection_pool> pool,
+			std::string copy_command,
+			bulk_loader_option opt = {}
+		) {
+			std::shared_ptr<bulk_loader> loader(new bulk_loader(opt));
+			auto q = std::make_shared<query>(std::move(copy_command));
+			using started_type = std::pair<std::shared_ptr<connection>, std::exception_ptr>;
+			std::vector<std::function<awaitable<started_type>()>> tasks;
+			// 每个流占用一个连接直到 finish(), 超过可借出的连接数时后发起的流永远等不到连接
+			auto max_streams = static_cast<std::size_t>(std::max(pool->concurrency_limit(), 1));
+			auto streams = std::clamp<std::size_t>(opt.streams, 1, max_streams);
+			for (std::size_t i = 0; i < streams; ++i) {
+				tasks.push_back([pool, q]() {
+					return start_stream(pool, q);
+				});
+			}
+			auto started = co_await detail::fan_out(pool->get_executor(), std::move(tasks));
+			std::exception_ptr error;
+			for (const auto& [conn, e] : started) {
+				if (e && !error) {
+					error = e;
+				}
+			}
+			if (error) {
+				// 已进入 COPY 状态的连接先中止再归还
+				for (auto& [conn, e] : started) {
+					if (conn) {
+						co_await conn->async_copy_abort("bulk loader open failed", use_awaitable);
+					}
+				}
+				std::rethrow_exception(error);
+			}
+			loader->m_start = clock_type::now();
+			for (auto& started_stream : started) {
+				auto s = std::make_shared<stream>();
+				s->conn = std::move(started_stream.first);
+				s->totals = loader->m_totals;
+				s->buffer_bytes = std::max(opt.buffer_bytes, opt.chunk_bytes);
+				co_spawn(s->conn->get_executor(), writer(s), detached);
+				loader->m_streams.push_back(std::move(s));
+			}
+			co_return loader;
+		}
+
+		bulk_loader(const bulk_loader&) = delete;
+		bulk_loader& operator=(const bulk_loader&) = delete;
+
+		/**
+		 * @brief 未 finish() 时中止各流的 COPY
+		 */
+		~bulk_loader() {
+			for (auto& s : m_streams) {
+				notify(s, [](stream& s) {
+					s.aborting = true;
+				}, &stream::writer_waiters);
+			}
+		}
+
+		/**
+		 * @brief 追加一行, 当前流缓冲区已满时等待
+		 */
+		template <typename ...Args>
+		awaitable<void> add(const Args& ...args) {
+			append_copy_row(m_current.data, args...);
+			++m_current.rows;
+			if (m_current.data.size() >= m_option.chunk_bytes) {
+				co_await submit();
+			}
+		}
+
+		/**
+		 * @brief 追加已编码的 COPY 文本数据, 须以完整的行结束
+		 */
+		awaitable<void> add_raw(std::string_view data, std::size_t rows) {
+			m_current.data.append(data);
+			m_current.rows += rows;
+			if (m_current.data.size() >= m_option.chunk_bytes) {
+				co_await submit();
+			}
+		}
+
+		/**
+		 * @brief 写出剩余数据并结束全部 COPY, 任一流失败时抛出第一个错误
+		 */
+		awaitable<bulk_load_stats> finish() {
+			if (!m_current.data.empty()) {
+				co_await submit();
+			}
+			for (auto& s : m_streams) {
+				notify(s, [](stream& s) {
+					s.closing = true;
+				}, &stream::writer_waiters);
+			}
+			std::exception_ptr error;
+			for (auto& s : m_streams) {
+				co_await detail::wait_until(s, &stream::producer_waiters, [](const stream& s) {
+					return s.done;
+				});
+				if (s->error && !error) {
+					error = s->error;
+				}
+			}
+			auto result = stats();
+			m_streams.clear();
+			if (error) {
+				std::rethrow_exception(error);
+			}
+			co_return result;
+		}
+
+		/**
+		 * @brief 当前吞吐统计, 线程安全
+		 */
+		bulk_load_stats stats() const {
+			bulk_load_stats s;
+			s.rows = m_totals->rows.load(std::memory_order_relaxed);
+			s.bytes = m_totals->bytes.load(std::memory_order_relaxed);
+			s.elapsed = clock_type::now() - m_start;
+			return s;
+		}
+
+		std::size_t streams() const {
+			return m_streams.size();
+		}
+
+	private:
+		explicit bulk_loader(const bulk_loader_option& opt)
+			:m_option(opt), m_totals(std::make_shared<counters>()), m_start(clock_type::now())
+		{
+			m_current.data.reserve(m_option.chunk_bytes + m_option.chunk_bytes / 8);
+		}
+
+		/**
+		 * @brief 把当前块交给下一个流, 流缓冲区已满时等待
+		 */
+		awaitable<void> submit() {
+			auto& s = m_streams[m_next];
+			m_next = (m_next + 1) % m_streams.size();
+			co_await detail::wait_until(s, &stream::producer_waiters, [](const stream& s) {
+				return s.queued_bytes < s.buffer_bytes || s.error || s.done;
+			});
+			auto size = m_current.data.size();
+			bool accepted = false;
+			notify(s, [this, &accepted, size](stream& s) {
+				if (!s.error && !s.done) {
+					s.queued_bytes += size;
+					s.chunks.push_back(std::move(m_current));
+					accepted = true;
+				}
+			}, &stream::writer_waiters);
+			if (!accepted) {
+				std::unique_lock lock(s->mutex);
+				if (s->error) {
+					std::rethrow_exception(s->error);
+				}
+				throw std::logic_error("bulk loader stream closed");
+			}
+			m_current = chunk{};
+			m_current.data.reserve(m_option.chunk_bytes + m_option.chunk_bytes / 8);
+		}
+
+		/**
+		 * @brief 借出连接并进入 COPY 状态, 失败时返回异常而不抛出, 以便中止其他已开始的流
+		 */
+		static awaitable<std::pair<std::shared_ptr<connection>, std::exception_ptr>> start_stream(
+			std::shared_ptr<connection_pool> pool,
+			std::shared_ptr<query> q
+		) {
+			try {
+				auto conn = co_await pool->get(use_awaitable);
+				auto results = co_await conn->async_copy_start(q, use_awaitable);
+				throw_if_copy_error(results);
+				if (results.empty() || results.back()->status() != PGRES_COPY_IN) {
+					throw std::invalid_argument("bulk loader command is not COPY FROM STDIN");
+				}
+				co_return std::make_pair(conn, std::exception_ptr{});
+			}
+			catch (...) {
+				co_return std::make_pair(std::shared_ptr<connection>{}, std::current_exception());
+			}
+		}
+
+		/**
+		 * @brief 每个流一个写协程: 依次写出排队的块, 结束或中止时收尾 COPY
+		 */
+		static awaitable<void> writer(std::shared_ptr<stream> s) {
+			try {
+				for (;;) {
+					co_await detail::wait_until(s, &stream::writer_waiters, [](const stream& s) {
+						return !s.chunks.empty() || s.closing || s.aborting;
+					});
+					chunk c;
+					{
+						std::unique_lock lock(s->mutex);
+						if (s->aborting || s->chunks.empty()) {
+							break;
+						}
+						c = std::move(s->chunks.front());
+						s->chunks.pop_front();
+					}
+					co_await s->conn->async_copy_write(boost::asio::buffer(c.data), use_awaitable);
+					s->totals->rows.fetch_add(c.rows, std::memory_order_relaxed);
+					s->totals->bytes.fetch_add(c.data.size(), std::memory_order_relaxed);
+					notify(s, [size = c.data.size()](stream& s) {
+						s.queued_bytes -= size;
+					}, &stream::producer_waiters);
+				}
+				bool aborting;
+				{
+					std::unique_lock lock(s->mutex);
+					aborting = s->aborting;
+				}
+				if (aborting) {
+					co_await s->conn->async_copy_abort("bulk loader aborted", use_awaitable);
+				}
+				else {
+					throw_if_error(co_await s->conn->async_copy_end(use_awaitable));
+				}
+			}
+			catch (...) {
+				std::unique_lock lock(s->mutex);
+				s->error = std::current_exception();
+			}
+			notify(s, [](stream& s) {
+				s.done = true;
+				s.chunks.clear();
+			}, &stream::producer_waiters);
+		}
+
+		/**
+		 * @brief 在锁内修改流状态, 然后唤醒对应的等待者
+		 */
+		template <typename F>
+		static void notify(const std::shared_ptr<stream>& s, F&& f, detail::waiter_list stream::* list) {
+			std::vector<std::function<void()>> waiters;
+			{
+				std::unique_lock lock(s->mutex);
+				f(*s);
+				waiters = ((*s).*list).take();
+			}
+			detail::waiter_list::notify(std::move(waiters));
+		}
+
+	private:
+		bulk_loader_option m_option;
+		std::shared_ptr<counters> m_totals;
+		clock_type::time_point m_start;
+		std::vector<std::shared_ptr<stream>> m_streams;
+		std::size_t m_next{ 0 };
+		chunk m_current;
+	};
+
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <fmt/format.h>
+#include <pqcpp/connection.hpp>
+#include <pqcpp/result.hpp>
+#include <pqcpp/detail/waiter_list.hpp>
+
+namespace pqcpp {
+
+	struct cursor_option {
+		// 首批行数
+		int initial_batch = 1000;
+		int min_batch = 64;
+		int max_batch = 100000;
+		// 目标单批 FETCH 耗时, 批大小按实际耗时调整
+		std::chrono::milliseconds target_latency{ 20 };
+		// 处理当前批时预取下一批
+		bool prefetch = true;
+	};
+
+	/**
+	 * @brief 服务端游标(DECLARE ... CURSOR / FETCH n)
+	 *
+	 * 须在事务内使用(兼容 pgbouncer 事务池). 开启预取时, 应用处理当前批期间
+	 * 下一批的 FETCH 已在同一连接上进行, 此时不要在该连接上执行其他查询(多路复用连接除外)
+	 *
+	 * @code
+	 * auto c = co_await cursor::open(conn, q);
+	 * while (auto batch = co_await c->next()) {
+	 *     for (auto row : *batch) { ... }
+	 * }
+	 * co_await c->close();
+	 * @endcode
+	 */
+	class cursor : public std::enable_shared_from_this<cursor> {
+		using clock_type = std::chrono::steady_clock;
+
+		struct fetch_state {
+			std::mutex mutex;
+			bool done{ false };
+			error_code ec;
+			std::vector<std::shared_ptr<result>> results;
+			int requested{ 0 };
+			clock_type::time_point start;
+			clock_type::duration elapsed{};
+			detail::waiter_list waiters;
+		};
+
+	public:
+		/**
+		 * @brief 声明游标并开始预取第一批
+		 *
+		 * @param conn 已开启事务的连接
+		 * @param q SELECT 语句, 参数一并传给 DECLARE
+		 */
+		static awaitable<std::shared_ptr<cursor>> open(
+			std::shared_ptr<connection> conn,
+			std::shared_ptr<query> q,
+			cursor_option opt = {}
+		) {
+			std::shared_ptr<cursor> c(new cursor(std::move(conn), std::move(opt)));
+			auto declare = q->with_command(fmt::format("DECLARE {} NO SCROLL CURSOR FOR {}", c->m_name, q->command()));
+			throw_if_error(co_await c->m_conn->async_query(declare, use_awaitable));
+			c->m_open = true;
+			if (c->m_option.prefetch) {
+				c->start_fetch();
+			}
+			co_return c;
+		}
+
+		cursor(const cursor&) = delete;
+		cursor& operator=(const cursor&) = delete;
+
+		/**
+		 * @brief 取下一批
+		 *
+		 * @return awaitable<std::shared_ptr<result>> 读完时为 nullptr
+		 */
+		awaitable<std::shared_ptr<result>> next() {
+			if (!m_open || (m_exhausted && !m_pending)) {
+				co_return nullptr;
+			}
+			if (!m_pending) {
+				start_fetch();
+			}
+			auto state = std::move(m_pending);
+			co_await wait(state);
+			if (state->ec) {
+				m_exhausted = true;
+				throw boost::system::system_error(state->ec);
+			}
+			for (const auto& r : state->results) {
+				if (!r->success()) {
+					// 事务已中止, 不再发送 FETCH
+					m_exhausted = true;
+					r->throw_if_error();
+				}
+			}
+			auto res = state->results.empty() ? nullptr : state->results.front();
+			int rows = res ? res->row_count() : 0;
+			if (rows < state->requested) {
+				m_exhausted = true;
+			}
+			else {
+				adapt(state->elapsed);
+				if (m_option.prefetch) {
+					start_fetch();
+				}
+			}
+			co_return rows > 0 ? res : nullptr;
+		}
+
+		/**
+		 * @brief 等待进行中的预取并关闭游标
+		 */
+		awaitable<void> close() {
+			if (m_pending) {
+				auto state = std::move(m_pending);
+				co_await wait(state);
+			}
+			if (m_open) {
+				m_open = false;
+				auto q = std::make_shared<query>(fmt::format("CLOSE {}", m_name));
+				throw_if_error(co_await m_conn->async_query(q, use_awaitable));
+			}
+		}
+
+		const std::string& name() const {
+			return m_name;
+		}
+
+		/**
+		 * @brief 下一次 next() 是否无需等待
+		 */
+		bool ready() const {
+			if (!m_open || (m_exhausted && !m_pending)) {
+				return true;
+			}
+			if (!m_pending) {
+				return false;
+			}
+			std::unique_lock lock(m_pending->mutex);
+			return m_pending->done;
+		}
+
+		/**
+		 * @brief 当前批大小
+		 */
+		int batch_size() const {
+			return m_batch;
+		}
+
+	private:
+		cursor(std::shared_ptr<connection> conn, cursor_option opt)
+			:m_conn(std::move(conn)), m_option(std::move(opt)),
+			m_name(fmt::format("pqcpp_cursor_{}", next_id++)),
+			m_batch(std::clamp(m_option.initial_batch, m_option.min_batch, m_option.max_batch))
+		{}
+
+		void start_fetch() {
+			auto state = std::make_shared<fetch_state>();
+			state->requested = m_batch;
+			state->start = clock_type::now();
+			auto q = std::make_shared<query>(fmt::format("FETCH FORWARD {} FROM {}", m_batch, m_name));
+			auto on_fetched = [state](error_code ec, std::vector<std::shared_ptr<result>> results) {
+				std::vector<std::function<void()>> waiters;
+				{
+					std::unique_lock lock(state->mutex);
+					state->ec = ec;
+					state->results = std::move(results);
+					state->elapsed = clock_type::now() - state->start;
+					state->done = true;
+					waiters = state->waiters.take();
+				}
+				detail::waiter_list::notify(std::move(waiters));
+			};
+			m_conn->async_query(q, on_fetched);
+			m_pending = std::move(state);
+		}
+
+		static awaitable<void> wait(std::shared_ptr<fetch_state> state) {
+			co_await detail::wait_until(state, &fetch_state::waiters, [](const fetch_state& s) {
+				return s.done;
+			});
+		}
+
+		/**
+		 * @brief 按实际耗时与目标耗时之比调整批大小, 单次最多翻倍/减半
+		 */
+		void adapt(clock_type::duration elapsed) {
+			auto elapsed_us = std::chrono::duration<double, std::micro>(elapsed).count();
+			auto target_us = std::chrono::duration<double, std::micro>(m_option.target_latency).count();
+			if (elapsed_us <= 0) {
+				return;
+			}
+			double ratio = std::clamp(target_us / elapsed_us, 0.5, 2.0);
+			m_batch = std::clamp(static_cast<int>(m_batch * ratio), m_option.min_batch, m_option.max_batch);
+		}
+
+	private:
+		std::shared_ptr<connection> m_conn;
+		cursor_option m_option;
+		std::string m_name;
+		int m_batch;
+		bool m_open{ false };
+		bool m_exhausted{ false };
+		std::shared_ptr<fetch_state> m_pending;
+
+		inline static std::atomic_size_t next_id = 0;
+	};
+
+	namespace detail {
+
+		/**
+		 * @brief 开启只读事务并打开游标, 供多连接并行读取使用
+		 */
+		inline awaitable<std::shared_ptr<cursor>> open_read_only_cursor(
+			std::shared_ptr<connection> conn,
+			std::shared_ptr<query> q,
+			transaction::level level,
+			cursor_option opt
+		) {
+			throw_if_error(co_await conn->async_start_transaction(level, transaction::READ_ONLY, use_awaitable));
+			co_return co_await cursor::open(std::move(conn), std::move(q), std::move(opt));
+		}
+
+		/**
+		 * @brief 关闭游标并结束事务, 出错只记录日志, 保证连接归还时不在事务中
+		 */
+		inline awaitable<bool> close_read_only_cursor(std::shared_ptr<connection> conn, std::shared_ptr<cursor> c) {
+			try {
+				if (c) {
+					co_await c->close();
+				}
+			}
+			catch (const std::exception& ex) {
+				PQCPP_LOG_WARN("conn {} close cursor failed: {}", conn->id(), ex.what());
+			}
+			if (conn->is_ready() && conn->transaction_status() != PQTRANS_IDLE) {
+				co_await conn->async_rollback_transaction(use_awaitable);
+			}
+			co_return true;
+		}
+
+	}
+
+}
@@ -43,12 +43,18 @@ namespace detail {
 
 		template <typename Self>
 		void operator()(Self& self, error_code ec = {}) {
+			if (!m_started) {
+				// 连接建立后的 start_io 与 io_engine 的读处理须在 strand 上进行
+				m_started = true;
+				boost::asio::post(m_conn.get_strand(), std::move(self));
+				return;
+			}
 			if (!m_native_conn) {
 				self.complete(error::make_error_code(error::pqcpp_ec::CONN_ALLOCATE_FAILED));
 				return;
 			}
 			if (ec) {
-				logger()->error("connection {} connect error {}: {}", m_conn.id(), ec.value(), ec.message());
+				PQCPP_LOG_ERROR("connection {} connect error {}: {}", m_conn.id(), ec.value(), ec.message());
 				if (m_native_conn) {
 					PQfinish(m_native_conn);
 				}
@@ -59,7 +65,7 @@ namespace detail {
 			if (status != PGRES_POLLING_FAILED) {
 				auto fd = PQsocket(m_native_conn);
 				if (fd != m_socket->native_handle()) {
-					logger()->debug("connection {} socket changed", m_conn.id());
+					PQCPP_LOG_DEBUG("connection {} socket changed", m_conn.id());
 					m_socket = make_socket(fd);
 				}
 			}
@@ -78,16 +84,17 @@ namespace detail {
 				break;
 			case PGRES_POLLING_OK:
 			{
-				logger()->info("connection {} connected", m_conn.id());
+				PQCPP_LOG_INFO("connection {} connected", m_conn.id());
 				m_conn.set_socket(std::move(m_socket));
 				m_conn.set_native_conn(m_native_conn);
+				m_conn.start_io();
 				self.complete(error_code{});
 				break;
 			}
 			case PGRES_POLLING_FAILED:
 			default:
 			{
-				logger()->error("connection {} connect failure: {}", m_conn.id(), PQerrorMessage(m_native_conn));
+				PQCPP_LOG_ERROR("connection {} connect failure: {}", m_conn.id(), PQerrorMessage(m_native_conn));
 				self.complete(error::make_error_code(error::pqcpp_ec::CONNECT_FAILED));
 			}
 			}
@@ -96,6 +103,7 @@ namespace detail {
 		Conn& m_conn;
         std::unique_ptr<socket_type> m_socket;
         ::pg_conn* m_native_conn;
+		bool m_started{ false };
     };
 
 }
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <optional>
+#include <libpq-fe.h>
+#include <boost/asio.hpp>
+#include <pqcpp/logger.hpp>
+#include <pqcpp/query.hpp>
+#include <pqcpp/error.hpp>
+#include <pqcpp/detail/io_engine.hpp>
+
+namespace pqcpp {
+namespace detail {
+
+	/**
+	 * @brief COPY FROM STDIN 各阶段共用的写出/失败处理
+	 */
+	template <typename Conn>
+	struct copy_op_base {
+		using socket_type = typename Conn::socket_type;
+
+		Conn& m_conn;
+		// 发送/写等待期间保持连接存活; 交给 io_engine 时转为弱引用, 见 io_engine::op_consumer
+		std::shared_ptr<Conn> m_conn_holder;
+		// 已发起写等待, 下次进入 operator() 即为一次唤醒
+		bool m_waiting{ false };
+		bool m_on_strand{ false };
+
+		explicit copy_op_base(Conn& conn)
+			:m_conn(conn), m_conn_holder(conn.weak_from_this().lock())
+		{}
+
+		/**
+		 * @brief 交给 io_engine 前放弃对连接的强引用
+		 */
+		std::weak_ptr<const void> release_holder() {
+			std::weak_ptr<const void> owner = m_conn_holder;
+			m_conn_holder.reset();
+			return owner;
+		}
+
+		/**
+		 * @brief 首次进入时转到连接 strand, 与 io_engine 的读处理串行访问 PGconn
+		 *
+		 * @return true 已转发, 调用方直接返回
+		 */
+		template <typename Self>
+		bool post_to_strand(Self& self) {
+			if (m_on_strand) {
+				return false;
+			}
+			m_on_strand = true;
+			boost::asio::post(m_conn.get_strand(), std::move(self));
+			return true;
+		}
+
+		void on_wakeup() {
+			if (m_waiting) {
+				m_waiting = false;
+				m_conn.get_io_stats().add(io_stats::write_wakeup);
+			}
+		}
+
+		template <typename Self>
+		void wait_write(Self& self) {
+			m_waiting = true;
+			m_conn.get_io_stats().add(io_stats::write_arm);
+			m_conn.get_socket().async_wait(socket_type::wait_write, boost::asio::bind_executor(
+				m_conn.get_strand(),
+				std::move(self)
+			));
+		}
+
+		/**
+		 * @brief 刷出 libpq 输出缓冲区, 未写完时等待可写后重入
+		 *
+		 * @return int 0 已写完, 1 等待中, -1 出错
+		 */
+		template <typename Self>
+		int flush(Self& self) {
+			int res = PQflush(m_conn.get_native_conn());
+			if (res == 1) {
+				wait_write(self);
+			}
+			return res;
+		}
+
+		/**
+		 * @brief 读取结果直到 NULL 或进入 COPY 状态
+		 */
+		bool poll_results(std::vector<std::shared_ptr<result>>& results) {
+			auto native_conn = m_conn.get_native_conn();
+			while (PQisBusy(native_conn) == 0) {
+				auto pg_res = PQgetResult(native_conn);
+				if (!pg_res) {
+					return true;
+				}
+				auto status = PQresultStatus(pg_res);
+				bool copy = status == PGRES_COPY_IN || status == PGRES_COPY_OUT || status == PGRES_COPY_BOTH;
+				results.push_back(std::make_shared<result>(pg_res));
+				if (copy) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		template <typename Self, typename ...Args>
+		void fail(Self& self, const error_code& ec, const char* stage, Args&&... args) {
+			PQCPP_LOG_ERROR("connection {} copy {} error: {}", m_conn.id(), stage, ec ? ec.message() : m_conn.error_message());
+			m_conn.disconnect();
+			self.complete(ec ? ec : error::make_error_code(error::pqcpp_ec::NETWORK_ERROR), std::forward<Args>(args)...);
+		}
+	};
+
+	/**
+	 * @brief 发送 COPY ... FROM STDIN(或 START_REPLICATION 等), 完成于服务端进入 COPY 状态或返回错误
+	 *
+	 * 无参数时使用简单查询协议, 复制连接只接受简单查询
+	 *
+	 * @tparam Conn
+	 * @handler void(boost::system::error_code, std::vector<std::shared_ptr<pqcpp::result>>)
+	 */
+	template <typename Conn>
+	struct copy_start_op : copy_op_base<Conn> {
+		enum { starting, writing, reading } state_{ starting };
+		std::shared_ptr<query> m_query;
+		std::vector<std::shared_ptr<result>> m_results;
+
+		copy_start_op(Conn& conn, std::shared_ptr<query> q)
+			:copy_op_base<Conn>(conn), m_query(std::move(q))
+		{
+			PQCPP_LOG_TRACE("copy: {}", m_query->command());
+		}
+
+		template <typename Self>
+		void operator()(Self& self, const error_code& ec = {}) {
+			if (this->post_to_strand(self)) {
+				return;
+			}
+			this->on_wakeup();
+			auto native_conn = this->m_conn.get_native_conn();
+			if (state_ == starting) {
+				if (!native_conn || this->m_conn.get_engine().closed()) {
+					this->fail(self, {}, "start", m_results);
+					return;
+				}
+#ifdef LIBPQ_HAS_PIPELINING
+				// COPY 不能在管道模式下执行
+				if (PQpipelineStatus(native_conn) != PQ_PIPELINE_OFF) {
+					PQexitPipelineMode(native_conn);
+				}
+#endif
+				bool sent = m_query->params_size() == 0
+					? PQsendQuery(native_conn, m_query->command()) == 1
+					: PQsendQueryParams(
+						native_conn,
+						m_query->command(),
+						m_query->params_size(),
+						nullptr,
+						m_query->params_values(),
+						m_query->params_lengths(),
+						m_query->params_formats(),
+						0
+					) == 1;
+				if (!sent) {
+					this->fail(self, error::make_error_code(error::pqcpp_ec::QUERY_FAILED), "send", m_results);
+					return;
+				}
+				state_ = writing;
+			}
+			if (state_ == reading || ec) {
+				this->fail(self, ec, "start", m_results);
+				return;
+			}
+			int res = this->flush(self);
+			if (res == -1) {
+				this->fail(self, ec, "write", m_results);
+			}
+			else if (res == 0) {
+				state_ = reading;
+				this->m_conn.get_engine().push(std::make_shared<io_engine::op_consumer<Self>>(std::move(self), this->release_holder()));
+			}
+		}
+
+		template <typename Self>
+		void operator()(Self&, input_poll poll) {
+			*poll.ready = this->poll_results(m_results);
+		}
+
+		template <typename Self>
+		void operator()(Self& self, input_ready) {
+			self.complete({}, std::move(m_results));
+		}
+
+		template <typename Self>
+		void operator()(Self& self, input_aborted) {
+			self.complete(boost::asio::error::operation_aborted, std::move(m_results));
+		}
+	};
+
+	/**
+	 * @brief 写入一块 COPY 数据并刷出, 完成时数据已交给内核, 以此形成背压
+	 *
+	 * @handler void(boost::system::error_code)
+	 */
+	template <typename Conn>
+	struct copy_data_op : copy_op_base<Conn> {
+		enum { putting, flushing } state_{ putting };
+		boost::asio::const_buffer m_buffer;
+
+		copy_data_op(Conn& conn, boost::asio::const_buffer buffer)
+			:copy_op_base<Conn>(conn), m_buffer(buffer)
+		{}
+
+		template <typename Self>
+		void operator()(Self& self, const error_code& ec = {}) {
+			if (this->post_to_strand(self)) {
+				return;
+			}
+			bool woke = this->m_waiting;
+			this->on_wakeup();
+			if (ec) {
+				this->fail(self, ec, "data");
+				return;
+			}
+			auto native_conn = this->m_conn.get_native_conn();
+			if (state_ == putting) {
+				if (woke && PQflush(native_conn) == -1) {
+					this->fail(self, ec, "write");
+					return;
+				}
+				int res = PQputCopyData(native_conn, static_cast<const char*>(m_buffer.data()), static_cast<int>(m_buffer.size()));
+				if (res == -1) {
+					this->fail(self, ec, "data");
+					return;
+				}
+				if (res == 0) {
+					// 非阻塞模式下缓冲区已满, 等待可写后重试
+					this->wait_write(self);
+					return;
+				}
+				state_ = flushing;
+			}
+			int res = this->flush(self);
+			if (res == -1) {
+				this->fail(self, ec, "write");
+			}
+			else if (res == 0) {
+				self.complete({});
+			}
+		}
+	};
+
+	/**
+	 * @brief 读取一条 COPY 数据(COPY OUT / COPY BOTH), 在连接 strand 上经 io_engine 等待输入
+	 *
+	 * 服务端结束 COPY 时读取最终结果, 以空数据完成; 最终结果为错误时 ec 为 QUERY_FAILED
+	 *
+	 * @handler void(boost::system::error_code, std::string)
+	 */
+	template <typename Conn>
+	struct copy_read_op : copy_op_base<Conn> {
+		enum { starting, reading } state_{ starting };
+		std::string m_data;
+		// 已读到 COPY 结束, 之后只读取最终结果
+		bool m_ended{ false };
+		bool m_failed{ false };
+		std::vector<std::shared_ptr<result>> m_results;
+
+		explicit copy_read_op(Conn& conn)
+			:copy_op_base<Conn>(conn)
+		{}
+
+		template <typename Self>
+		void operator()(Self& self, const error_code& ec = {}) {
+			if (state_ == starting) {
+				// 可能与状态回报的写操作并发, 读统一在 strand 上发起
+				state_ = reading;
+				boost::asio::post(this->m_conn.get_strand(), std::move(self));
+				return;
+			}
+			if (ec) {
+				this->fail(self, ec, "read", std::string{});
+				return;
+			}
+			this->m_conn.get_engine().push(std::make_shared<io_engine::op_consumer<Self>>(std::move(self), this->release_holder()));
+		}
+
+		template <typename Self>
+		void operator()(Self&, input_poll poll) {
+			auto native_conn = this->m_conn.get_native_conn();
+			if (!m_ended) {
+				char* buffer = nullptr;
+				int res = PQgetCopyData(native_conn, &buffer, 1);
+				if (res > 0) {
+					m_data.assign(buffer, static_cast<std::size_t>(res));
+					PQfreemem(buffer);
+					*poll.ready = true;
+					return;
+				}
+				if (res == 0) {
+					return;
+				}
+				if (res == -2) {
+					m_failed = true;
+					*poll.ready = true;
+					return;
+				}
+				m_ended = true;
+			}
+			*poll.ready = this->poll_results(m_results);
+		}
+
+		template <typename Self>
+		void operator()(Self& self, input_ready) {
+			if (m_failed) {
+				this->fail(self, {}, "read", std::string{});
+				return;
+			}
+			for (const auto& res : m_results) {
+				if (!res->success()) {
+					PQCPP_LOG_ERROR("connection {} copy ended with error: {}", this->m_conn.id(), res->error_message());
+					self.complete(error::make_error_code(error::pqcpp_ec::QUERY_FAILED), std::string{});
+					return;
+				}
+			}
+			self.complete({}, std::move(m_data));
+		}
+
+		template <typename Self>
+		void operator()(Self& self, input_aborted) {
+			self.complete(boost::asio::error::operation_aborted, std::string{});
+		}
+	};
+
+	/**
+	 * @brief 结束(或以错误信息中止) COPY 并读取最终结果
+	 *
+	 * @handler void(boost::system::error_code, std::vector<std::shared_ptr<pqcpp::result>>)
+	 */
+	template <typename Conn>
+	struct copy_end_op : copy_op_base<Conn> {
+		enum { putting, flushing, reading } state_{ putting };
+		std::optional<std::string> m_error_message;
+		std::vector<std::shared_ptr<result>> m_results;
+
+		copy_end_op(Conn& conn, std::optional<std::string> error_message)
+			:copy_op_base<Conn>(conn), m_error_message(std::move(error_message))
+		{}
+
+		template <typename Self>
+		void operator()(Self& self, const error_code& ec = {}) {
+			if (this->post_to_strand(self)) {
+				return;
+			}
+			bool woke = this->m_waiting;
+			this->on_wakeup();
+			if (ec || state_ == reading) {
+				this->fail(self, ec, "end", m_results);
+				return;
+			}
+			auto native_conn = this->m_conn.get_native_conn();
+			if (state_ == putting) {
+				if (woke && PQflush(native_conn) == -1) {
+					this->fail(self, ec, "write", m_results);
+					return;
+				}
+				int res = PQputCopyEnd(native_conn, m_error_message ? m_error_message->c_str() : nullptr);
+				if (res == -1) {
+					this->fail(self, ec, "end", m_results);
+					return;
+				}
+				if (res == 0) {
+					this->wait_write(self);
+					return;
+				}
+				state_ = flushing;
+			}
+			int res = this->flush(self);
+			if (res == -1) {
+				this->fail(self, ec, "write", m_results);
+			}
+			else if (res == 0) {
+				state_ = reading;
+				this->m_conn.get_engine().push(std::make_shared<io_engine::op_consumer<Self>>(std::move(self), this->release_holder()));
+			}
+		}
+
+		template <typename Self>
+		void operator()(Self&, input_poll poll) {
+			*poll.ready = this->poll_results(m_results);
+		}
+
+		template <typename Self>
+		void operator()(Self& self, input_ready) {
+			PQCPP_LOG_DEBUG("connection {} copy end", this->m_conn.id());
+			self.complete({}, std::move(m_results));
+		}
+
+		template <typename Self>
+		void operator()(Self& self, input_aborted) {
+			self.complete(boost::asio::error::operation_aborted, std::move(m_results));
+		}
+	};
+
+}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <boost/asio.hpp>
+#include <pqcpp/coro.hpp>
+#include <pqcpp/detail/waiter_list.hpp>
+
+namespace pqcpp {
+namespace detail {
+
+	/**
+	 * @brief 并发执行一组协程并按原顺序收集结果
+	 *
+	 * 全部完成后返回; 任一协程抛出异常时, 等其余协程结束后重新抛出第一个异常
+	 *
+	 * @tparam T 协程返回值类型, 须可默认构造
+	 */
+	template <typename T>
+	awaitable<std::vector<T>> fan_out(
+		boost::asio::any_io_executor executor,
+		std::vector<std::function<awaitable<T>()>> tasks
+	) {
+		struct state {
+			std::mutex mutex;
+			std::size_t remaining{ 0 };
+			std::vector<T> values;
+			std::exception_ptr error;
+			waiter_list waiters;
+		};
+		if (tasks.empty()) {
+			co_return std::vector<T>{};
+		}
+		auto s = std::make_shared<state>();
+		s->remaining = tasks.size();
+		s->values.resize(tasks.size());
+		for (std::size_t i = 0; i < tasks.size(); ++i) {
+			co_spawn(executor, tasks[i](), [s, i](std::exception_ptr e, T value) {
+				std::vector<std::function<void()>> waiters;
+				{
+					std::unique_lock lock(s->mutex);
+					if (e) {
+						if (!s->error) {
+							s->error = e;
+						}
+					}
+					else {
+						s->values[i] = std::move(value);
+					}
+					if (--s->remaining == 0) {
+						waiters = s->waiters.take();
+					}
+				}
+				waiter_list::notify(std::move(waiters));
+			});
+		}
+		co_await wait_until(s, &state::waiters, [](const state& s) {
+			return s.remaining == 0;
+		});
+		if (s->error) {
+			std::rethrow_exception(s->error);
+		}
+		co_return std::move(s->values);
+	}
+
+}
+}
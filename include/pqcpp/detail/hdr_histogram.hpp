@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+namespace pqcpp {
+namespace detail {
+
+	/**
+	 * @brief 对数-线性分桶直方图(HDR 风格)
+	 *
+	 * 每个 2 的幂区间再线性分为 2^(SubBits-1) 个子桶, 相对误差约 1/2^(SubBits-1);
+	 * 桶数组按记录到的最大值增长, 非线程安全
+	 *
+	 * @tparam SubBits 子桶精度位数
+	 */
+	template <unsigned SubBits = 6>
+	class hdr_histogram {
+		static constexpr std::uint64_t sub_count = 1ull << SubBits;
+		static constexpr std::uint64_t half_count = sub_count / 2;
+
+	public:
+		void record(std::uint64_t value) {
+			auto index = index_of(value);
+			if (index >= m_counts.size()) {
+				m_counts.resize(index + 1, 0);
+			}
+			++m_counts[index];
+			++m_total;
+			m_min = std::min(m_min, value);
+			m_max = std::max(m_max, value);
+		}
+
+		std::uint64_t count() const {
+			return m_total;
+		}
+
+		std::uint64_t min() const {
+			return m_total ? m_min : 0;
+		}
+
+		std::uint64_t max() const {
+			return m_max;
+		}
+
+		/**
+		 * @brief 分位值
+		 *
+		 * @param percentile 0 ~ 100
+		 * @return std::uint64_t 所在桶的上界(不超过记录到的最大值)
+		 */
+		std::uint64_t percentile(double percentile) const {
+			if (m_total == 0) {
+				return 0;
+			}
+			auto rank = static_cast<std::uint64_t>(std::clamp(percentile, 0.0, 100.0) / 100.0 * m_total + 0.5);
+			rank = std::clamp<std::uint64_t>(rank, 1, m_total);
+			std::uint64_t seen = 0;
+			for (std::size_t i = 0; i < m_counts.size(); ++i) {
+				seen += m_counts[i];
+				if (seen >= rank) {
+					return std::min(highest_equivalent(i), m_max);
+				}
+			}
+			return m_max;
+		}
+
+		void merge(const hdr_histogram& other) {
+			if (other.m_counts.size() > m_counts.size()) {
+				m_counts.resize(other.m_counts.size(), 0);
+			}
+			for (std::size_t i = 0; i < other.m_counts.size(); ++i) {
+				m_counts[i] += other.m_counts[i];
+			}
+			m_total += other.m_total;
+			m_min = std::min(m_min, other.m_min);
+			m_max = std::max(m_max, other.m_max);
+		}
+
+	private:
+		static std::size_t index_of(std::uint64_t value) {
+			if (value < sub_count) {
+				return static_cast<std::size_t>(value);
+			}
+			unsigned msb = 63;
+			while (!(value >> msb)) {
+				--msb;
+			}
+			unsigned bucket = msb - (SubBits - 1);
+			return static_cast<std::size_t>(bucket * half_count + (value >> bucket));
+		}
+
+		static std::uint64_t highest_equivalent(std::size_t index) {
+			if (index < sub_count) {
+				return index;
+			}
+			std::uint64_t bucket = index / half_count - 1;
+			std::uint64_t sub = index - bucket * half_count;
+			return ((sub + 1) << bucket) - 1;
+		}
+
+	private:
+		std::vector<std::uint32_t> m_counts;
+		std::uint64_t m_total{ 0 };
+		std::uint64_t m_min{ std::numeric_limits<std::uint64_t>::max() };
+		std::uint64_t m_max{ 0 };
+	};
+
+}
+}
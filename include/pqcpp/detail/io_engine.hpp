@@ -0,0 +1,382 @@
+#pragma once
+
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <libpq-fe.h>
+#include <boost/asio.hpp>
+#include <pqcpp/error.hpp>
+#include <pqcpp/logger.hpp>
+#include <pqcpp/io_stats.hpp>
+
+namespace pqcpp {
+namespace detail {
+
+	/**
+	 * @brief 传给 composed op 的轮询请求, 由 op 写入是否已完成
+	 */
+	struct input_poll {
+		bool* ready;
+		// 本次轮询前有新数据读入
+		bool woke;
+	};
+
+	/**
+	 * @brief 传给 composed op 的完成通知, op 已从 io_engine 移除
+	 */
+	struct input_ready {};
+
+	/**
+	 * @brief 传给 composed op 的中止通知, op 所属连接已析构, op 不可再访问连接
+	 */
+	struct input_aborted {};
+
+	/**
+	 * @brief 连接级 I/O 引擎
+	 *
+	 * 持有 socket 和 PGconn, 在连接存活期间保持一个读等待; 每次可读时读入全部输入,
+	 * 再按 FIFO 交给当前活动的操作(查询/COPY 等), 没有活动操作时处理异步通知.
+	 * 所有成员函数须在连接 strand 上调用
+	 */
+	class io_engine : public std::enable_shared_from_this<io_engine> {
+	public:
+		using socket_type = boost::asio::ip::tcp::socket;
+		using strand_type = boost::asio::strand<boost::asio::any_io_executor>;
+		using notification_handler = std::function<void(const PGnotify&)>;
+
+		/**
+		 * @brief 输入消费者
+		 */
+		class consumer {
+		public:
+			virtual ~consumer() {}
+
+			/**
+			 * @brief 检查 libpq 缓冲区中的输入, 不可阻塞
+			 *
+			 * @param woke 本次之前有新数据读入
+			 * @return true 操作已完成, 将被移除后调用 complete()
+			 */
+			virtual bool poll(bool woke) = 0;
+
+			virtual void complete() = 0;
+
+			virtual void fail(const error_code& ec) = 0;
+		};
+
+		/**
+		 * @brief 将 async_compose 的 self 包装为消费者
+		 *
+		 * op 需要实现 operator()(Self&, input_poll), operator()(Self&, input_ready),
+		 * operator()(Self&, input_aborted) 和 operator()(Self&, const error_code&)
+		 *
+		 * 排队期间 op 只经由 owner 弱引用所属连接(连接持有引擎, 强引用会形成循环),
+		 * 每次回调前锁定; 连接已析构时以 input_aborted 结束
+		 */
+		template <typename Self>
+		class op_consumer : public consumer {
+		public:
+			explicit op_consumer(Self&& self, std::weak_ptr<const void> owner = {})
+				:m_self(std::move(self)), m_owner(owner), m_owned(!owner.expired())
+			{}
+
+			bool poll(bool woke) override {
+				auto pin = m_owner.lock();
+				if (m_owned && !pin) {
+					return true;
+				}
+				bool ready = false;
+				m_self(input_poll{ &ready, woke });
+				return ready;
+			}
+
+			void complete() override {
+				auto pin = m_owner.lock();
+				if (m_owned && !pin) {
+					m_self(input_aborted{});
+					return;
+				}
+				m_self(input_ready{});
+			}
+
+			void fail(const error_code& ec) override {
+				auto pin = m_owner.lock();
+				if (m_owned && !pin) {
+					m_self(input_aborted{});
+					return;
+				}
+				m_self(ec);
+			}
+
+		private:
+			Self m_self;
+			std::weak_ptr<const void> m_owner;
+			bool m_owned;
+		};
+
+		explicit io_engine(strand_type strand)
+			:m_strand(std::move(strand))
+		{}
+
+		~io_engine() {
+			release();
+		}
+
+		io_engine(const io_engine&) = delete;
+		io_engine& operator=(const io_engine&) = delete;
+
+		socket_type* socket() {
+			return m_socket.get();
+		}
+
+		::pg_conn* native_conn() {
+			return m_native_conn;
+		}
+
+		void set_socket(std::unique_ptr<socket_type>&& socket) {
+			m_socket = std::move(socket);
+		}
+
+		void set_native_conn(::pg_conn* native_conn) {
+			m_native_conn = native_conn;
+		}
+
+		io_stats& stats() {
+			return m_stats;
+		}
+
+		bool closed() const {
+			return m_closed;
+		}
+
+		/**
+		 * @brief 连接可用, 可在任意线程调用
+		 */
+		bool ready() const {
+			return m_ready.load(std::memory_order_acquire);
+		}
+
+		/**
+		 * @brief 最近一个操作完成时的事务状态, 可在任意线程调用
+		 */
+		PGTransactionStatusType transaction_status() const {
+			return m_transaction_status.load(std::memory_order_acquire);
+		}
+
+		void set_notification_handler(notification_handler handler) {
+			m_notification_handler = std::move(handler);
+		}
+
+		/**
+		 * @brief 连接建立后开始读
+		 */
+		void start() {
+			m_closed = false;
+			if (m_native_conn) {
+				PQsetnonblocking(m_native_conn, 1);
+			}
+			update_state();
+			arm_read();
+		}
+
+		/**
+		 * @brief 加入消费者, 若其位于队首立即轮询一次(输入可能已在缓冲区中)
+		 */
+		void push(std::shared_ptr<consumer> c) {
+			if (m_closed) {
+				c->fail(error::make_error_code(error::pqcpp_ec::NETWORK_ERROR));
+				return;
+			}
+			m_consumers.push_back(std::move(c));
+			// 查询已发出, 事务状态变为 ACTIVE
+			update_state();
+			if (m_consumers.size() == 1) {
+				dispatch(false);
+			}
+		}
+
+		std::size_t pending() const {
+			return m_consumers.size();
+		}
+
+		/**
+		 * @brief 发送 libpq 输出缓冲区, 未写完时由引擎持有唯一的写等待继续发送
+		 *
+		 * @return false 写出错
+		 */
+		bool flush() {
+			int res = PQflush(m_native_conn);
+			if (res == -1) {
+				return false;
+			}
+			if (res == 1) {
+				arm_write();
+			}
+			return true;
+		}
+
+		/**
+		 * @brief 关闭连接, 未完成的消费者以 ec 失败
+		 */
+		void close(const error_code& ec = boost::asio::error::operation_aborted) {
+			if (m_closed && !m_socket && !m_native_conn) {
+				return;
+			}
+			m_closed = true;
+			release();
+			update_state();
+			fail_all(ec);
+		}
+
+	private:
+		void arm_read() {
+			if (m_read_armed || m_closed || !m_socket) {
+				return;
+			}
+			m_read_armed = true;
+			m_stats.add(io_stats::read_arm);
+			m_socket->async_wait(socket_type::wait_read, boost::asio::bind_executor(
+				m_strand,
+				[self = shared_from_this()](const error_code& ec) {
+					self->on_readable(ec);
+				}
+			));
+		}
+
+		void arm_write() {
+			if (m_write_armed || m_closed || !m_socket) {
+				return;
+			}
+			m_write_armed = true;
+			m_stats.add(io_stats::write_arm);
+			m_socket->async_wait(socket_type::wait_write, boost::asio::bind_executor(
+				m_strand,
+				[self = shared_from_this()](const error_code& ec) {
+					self->on_writable(ec);
+				}
+			));
+		}
+
+		void on_writable(const error_code& ec) {
+			m_write_armed = false;
+			if (m_closed) {
+				return;
+			}
+			if (!ec) {
+				m_stats.add(io_stats::write_wakeup);
+			}
+			if (ec || !flush()) {
+				PQCPP_LOG_ERROR("connection write error: {}", ec ? ec.message() : PQerrorMessage(m_native_conn));
+				close(ec ? ec : error::make_error_code(error::pqcpp_ec::NETWORK_ERROR));
+			}
+		}
+
+		void on_readable(const error_code& ec) {
+			m_read_armed = false;
+			if (m_closed) {
+				return;
+			}
+			if (ec) {
+				PQCPP_LOG_ERROR("connection read error {}: {}", ec.value(), ec.message());
+				close(ec);
+				return;
+			}
+			m_stats.add(io_stats::read_wakeup);
+			if (m_stats.detail_enabled()) {
+				error_code ignore_ec;
+				auto available = m_socket->available(ignore_ec);
+				m_stats.add(io_stats::bytes_read, available);
+				if (available == 0) {
+					m_stats.add(io_stats::spurious_wakeup);
+				}
+			}
+			m_stats.add(io_stats::consume_call);
+			if (PQconsumeInput(m_native_conn) == 0) {
+				PQCPP_LOG_ERROR("connection consume input error: {}", PQerrorMessage(m_native_conn));
+				close(error::make_error_code(error::pqcpp_ec::NETWORK_ERROR));
+				return;
+			}
+			update_state();
+			dispatch(true);
+			arm_read();
+		}
+
+		void dispatch(bool woke) {
+			// 完成的操作可能持有连接的最后一个引用, 连接析构时引擎随之释放
+			auto guard = shared_from_this();
+			while (!m_consumers.empty() && !m_closed) {
+				if (!m_consumers.front()->poll(woke)) {
+					break;
+				}
+				auto c = std::move(m_consumers.front());
+				m_consumers.pop_front();
+				// 完成回调可能在其他线程读取状态镜像
+				update_state();
+				c->complete();
+				// 同一批输入可能已包含后续操作的结果
+				woke = true;
+			}
+			if (m_consumers.empty() && !m_closed) {
+				drain_notifications();
+			}
+		}
+
+		/**
+		 * @brief 刷新供其他线程读取的状态镜像
+		 */
+		void update_state() {
+			bool ready = !m_closed && m_socket && m_native_conn && PQstatus(m_native_conn) == CONNECTION_OK;
+			m_ready.store(ready, std::memory_order_release);
+			m_transaction_status.store(ready ? PQtransactionStatus(m_native_conn) : PQTRANS_UNKNOWN, std::memory_order_release);
+		}
+
+		void drain_notifications() {
+			while (auto notify = PQnotifies(m_native_conn)) {
+				if (m_notification_handler) {
+					m_notification_handler(*notify);
+				}
+				PQfreemem(notify);
+			}
+		}
+
+		void fail_all(const error_code& ec) {
+			auto guard = shared_from_this();
+			while (!m_consumers.empty()) {
+				auto c = std::move(m_consumers.front());
+				m_consumers.pop_front();
+				c->fail(ec);
+			}
+		}
+
+		void release() {
+			if (m_socket) {
+				error_code ignore_ec;
+				m_socket->cancel(ignore_ec);
+				m_stats.add(io_stats::cancel);
+				// fd 属于 libpq, 交还给 PQfinish 关闭
+				m_socket->release(ignore_ec);
+				m_socket.reset();
+			}
+			if (m_native_conn) {
+				PQfinish(m_native_conn);
+				m_native_conn = nullptr;
+			}
+		}
+
+	private:
+		strand_type m_strand;
+		std::unique_ptr<socket_type> m_socket;
+		::pg_conn* m_native_conn{ nullptr };
+		std::deque<std::shared_ptr<consumer>> m_consumers;
+		notification_handler m_notification_handler;
+		io_stats m_stats;
+		bool m_read_armed{ false };
+		bool m_write_armed{ false };
+		bool m_closed{ false };
+		std::atomic_bool m_ready{ false };
+		std::atomic<PGTransactionStatusType> m_transaction_status{ PQTRANS_UNKNOWN };
+	};
+
+}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+namespace pqcpp {
+namespace detail {
+
+	/**
+	 * @brief 复制协议消息及二进制格式字段读取, 整数为网络字节序
+	 */
+	class wire_reader {
+	public:
+		explicit wire_reader(std::string_view data)
+			:m_data(data)
+		{}
+
+		std::uint8_t u8() {
+			return static_cast<std::uint8_t>(*take(1));
+		}
+
+		std::int16_t i16() {
+			return static_cast<std::int16_t>(read_uint<std::uint16_t>());
+		}
+
+		std::int32_t i32() {
+			return static_cast<std::int32_t>(read_uint<std::uint32_t>());
+		}
+
+		std::uint32_t u32() {
+			return read_uint<std::uint32_t>();
+		}
+
+		std::int64_t i64() {
+			return static_cast<std::int64_t>(read_uint<std::uint64_t>());
+		}
+
+		std::uint64_t u64() {
+			return read_uint<std::uint64_t>();
+		}
+
+		/**
+		 * @brief 以 '\0' 结尾的字符串
+		 */
+		std::string cstr() {
+			auto end = m_data.find('\0', m_pos);
+			if (end == std::string_view::npos) {
+				throw std::runtime_error("replication message string not terminated");
+			}
+			std::string s(m_data.substr(m_pos, end - m_pos));
+			m_pos = end + 1;
+			return s;
+		}
+
+		std::string bytes(std::size_t size) {
+			return std::string(take(size), size);
+		}
+
+		std::string_view view(std::size_t size) {
+			return std::string_view(take(size), size);
+		}
+
+		bool empty() const {
+			return m_pos >= m_data.size();
+		}
+
+	private:
+		const char* take(std::size_t size) {
+			if (m_data.size() - m_pos < size) {
+				throw std::runtime_error("replication message truncated");
+			}
+			auto p = m_data.data() + m_pos;
+			m_pos += size;
+			return p;
+		}
+
+		template <typename T>
+		T read_uint() {
+			auto p = reinterpret_cast<const unsigned char*>(take(sizeof(T)));
+			T value = 0;
+			for (std::size_t i = 0; i < sizeof(T); ++i) {
+				value = static_cast<T>((value << 8) | p[i]);
+			}
+			return value;
+		}
+
+	private:
+		std::string_view m_data;
+		std::size_t m_pos{ 0 };
+	};
+
+	template <typename T>
+	void write_uint(std::string& out, T value) {
+		for (std::size_t i = sizeof(T); i > 0; --i) {
+			out.push_back(static_cast<char>((value >> ((i - 1) * 8)) & 0xff));
+		}
+	}
+
+	// PostgreSQL 时间戳的纪元 2000-01-01 相对 Unix 纪元的微秒数
+	inline constexpr std::int64_t pg_epoch_offset_us = 946684800LL * 1000000;
+
+	inline std::chrono::system_clock::time_point from_pg_timestamp(std::int64_t us) {
+		return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+			std::chrono::microseconds(us + pg_epoch_offset_us)
+		));
+	}
+
+	inline std::int64_t to_pg_timestamp(std::chrono::system_clock::time_point tp) {
+		return std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count() - pg_epoch_offset_us;
+	}
+
+}
+}
@@ -2,10 +2,14 @@
 
 #include <memory>
 #include <functional>
+#include <chrono>
 #include <libpq-fe.h>
 #include <boost/asio.hpp>
 #include <pqcpp/logger.hpp>
 #include <pqcpp/query.hpp>
+#include <pqcpp/tracer.hpp>
+#include <pqcpp/statement_stats.hpp>
+#include <pqcpp/detail/io_engine.hpp>
 #include <fmt/ostream.h>
 #include <fmt/ranges.h>
 
@@ -22,20 +26,58 @@ namespace detail {
     struct query_op
     {
         using socket_type = typename Conn::socket_type;
-		enum { starting, writing, reading, done } state_;
+		enum { starting, sending, writing, reading, done } state_;
 
 		Conn& m_conn;
+		// 发送/写等待期间保持连接存活; 交给 io_engine 时转为弱引用, 见 io_engine::op_consumer
+		std::shared_ptr<Conn> m_conn_holder;
 		std::shared_ptr<query> m_query;
+		std::chrono::steady_clock::time_point m_start;
+		std::shared_ptr<query_tracer> m_tracer;
+		std::shared_ptr<statement_stats> m_statement_stats;
+		query_span m_span;
+		std::vector<std::shared_ptr<result>> m_results;
+		// 管道模式: 与同一连接上的其他查询背靠背发送, 结果以 sync 分隔
+		bool m_pipelined{ false };
+		// 同一 sync 内依次发送的语句, 为空时只发送 m_query(此时 m_query 仅用于统计)
+		std::vector<std::shared_ptr<query>> m_group;
+		// 组首/组尾执行成功时不返回给调用者的语句数(BEGIN/COMMIT)
+		std::size_t m_hide_prefix{ 0 };
+		std::size_t m_hide_suffix{ 0 };
+		// 当前结果所属语句序号及每个结果的语句序号
+		std::size_t m_statement{ 0 };
+		std::vector<std::size_t> m_result_statements;
+		// 已发起写等待, 下次进入 operator() 即为一次唤醒
+		bool m_waiting{ false };
 
-        query_op(Conn& conn, std::shared_ptr<query> query)
-            :m_conn(conn), m_query(query), state_(starting)
+        query_op(Conn& conn, std::shared_ptr<query> query, bool pipelined = false)
+            :state_(starting), m_conn(conn), m_conn_holder(conn.weak_from_this().lock()), m_query(query), m_pipelined(pipelined)
         {
 
-			logger()->trace("query: {}\tparameters: {}", query->m_cmd, query->m_params_values);
+			PQCPP_LOG_TRACE("query: {}\tparameters: {}", query->m_cmd, query->m_params_values);
+		}
+
+		/**
+		 * @brief 一次往返发送一组语句(管道模式, 末尾一个 sync)
+		 *
+		 * @param query 用于统计/追踪的代表语句
+		 * @param group 依次发送的语句
+		 */
+		query_op(
+			Conn& conn,
+			std::shared_ptr<query> query,
+			std::vector<std::shared_ptr<pqcpp::query>> group,
+			std::size_t hide_prefix,
+			std::size_t hide_suffix
+		)
+			:state_(starting), m_conn(conn), m_conn_holder(conn.weak_from_this().lock()), m_query(query), m_pipelined(true),
+			m_group(std::move(group)), m_hide_prefix(hide_prefix), m_hide_suffix(hide_suffix)
+		{
+			PQCPP_LOG_TRACE("query group: {} statements", m_group.size());
 		}
 
         bool send_query(const query& q) {
-			if (q.m_params_values.size() == 0) {
+			if (q.m_params_values.size() == 0 && q.result_format() == text_format) {
 				return PQsendQuery(
 					m_conn.get_native_conn(),
 					q.command()
@@ -50,74 +92,302 @@ namespace detail {
 					q.params_values(),
 					q.params_lengths(),
 					q.params_formats(),
-					0
+					q.result_format()
 				) == 1;
 			}
 		}
 
 		template <typename Self>
 		void on_query_complete(Self& self) {
-            m_conn.get_socket().cancel();
-            std::vector<std::shared_ptr<result>> results;
-            while (auto pg_res = PQgetResult(m_conn.get_native_conn())) {
-                results.push_back(std::make_shared<result>(pg_res));
-            }
-			if(results.empty()){
-				int i  = 1;
+			auto results = std::move(m_results);
+			if (m_hide_suffix) {
+				// 组尾(COMMIT)失败后事务已结束, 记录在连接上供 transaction() 抛出
+				for (std::size_t i = 0; i < results.size(); ++i) {
+					if (m_result_statements[i] + m_hide_suffix >= m_group.size() && !results[i]->success()) {
+						m_conn.note_commit_failure(results[i]);
+					}
+				}
+			}
+			if (m_hide_prefix || m_hide_suffix) {
+				hide_results(results);
+			}
+			auto now = std::chrono::steady_clock::now();
+			query_stats stats{ *m_query, now - m_start, true, 0, 0, 0 };
+			if (m_tracer || m_statement_stats || m_conn.has_query_observer()) {
+				stats.bytes_sent = m_query->payload_size();
+				for (const auto& res : results) {
+					stats.bytes_received += res->memory_size();
+					stats.rows += static_cast<std::size_t>(res->row_count());
+					stats.sql_error = stats.sql_error || !res->success();
+				}
 			}
+			finish_span(now, stats);
+			if (m_statement_stats) {
+				m_statement_stats->record(stats);
+			}
+			m_conn.notify_query_done(stats);
 			self.complete({}, std::move(results));
 		}
 
 		template <typename Self>
 		void on_query_failure(Self& self, const error_code& ec) {
+			auto now = std::chrono::steady_clock::now();
+			query_stats stats{ *m_query, now - m_start, false, m_query->payload_size(), 0, 0 };
+			finish_span(now, stats);
+			if (m_statement_stats) {
+				m_statement_stats->record(stats);
+			}
+			m_conn.notify_query_done(stats);
 			m_conn.disconnect();
 			self.complete(ec, {});
 		}
 
+		/**
+		 * @brief 去掉执行成功的组首/组尾语句结果, 失败的保留以便调用者看到原因
+		 */
+		void hide_results(std::vector<std::shared_ptr<result>>& results) {
+			std::size_t count = m_group.size();
+			std::size_t keep = 0;
+			for (std::size_t i = 0; i < results.size(); ++i) {
+				auto statement = m_result_statements[i];
+				bool hidden = statement < m_hide_prefix || statement + m_hide_suffix >= count;
+				if (!hidden || !results[i]->success()) {
+					results[keep++] = std::move(results[i]);
+				}
+			}
+			results.resize(keep);
+		}
+
+		/**
+		 * @brief 补齐未到达的阶段并上报 span
+		 */
+		void finish_span(std::chrono::steady_clock::time_point now, const query_stats& stats) {
+			if (!m_tracer) {
+				return;
+			}
+			using time_point = query_span::time_point;
+			for (auto point : { &m_span.flushed, &m_span.first_read, &m_span.ready }) {
+				if (*point == time_point{}) {
+					*point = now;
+				}
+			}
+			m_span.drained = now;
+			m_span.connection_id = m_conn.id();
+			m_span.statement = m_query->name().empty()
+				? std::string_view{ m_query->command() }
+				: std::string_view{ m_query->name() };
+			m_span.rows = stats.rows;
+			m_span.result_bytes = stats.bytes_received;
+			m_span.success = stats.success;
+			m_tracer->on_span(m_span);
+		}
+
 		template <typename Self>
 		void operator()(Self& self, const error_code& ec = {}) {
+			if (m_waiting) {
+				m_waiting = false;
+				m_conn.get_io_stats().add(io_stats::write_wakeup);
+			}
 			if (state_ == starting) {
-				if (!this->send_query(*this->m_query)) {
-					logger()->error(
-						"connection {} send query error: {}",
-						m_conn.id(),
-						m_conn.error_message()
-					);
-					this->on_query_failure(self, error::make_error_code(error::pqcpp_ec::QUERY_FAILED));
-					return;
-				}
-				state_ = writing;
+				m_start = std::chrono::steady_clock::now();
+				m_tracer = pqcpp::tracer();
+				m_statement_stats = global_statement_stats();
+				m_span.send = m_start;
+				// 发起者可能不在连接 strand 上, 而 io_engine 的读处理在 strand 上访问同一 PGconn,
+				// 发送统一转到 strand 上进行
+				state_ = sending;
+				boost::asio::post(m_conn.get_strand(), std::move(self));
+				return;
 			}
 			switch (state_) {
+			case sending:
+				if (m_pipelined) {
+					this->pipeline_send(self);
+				}
+				else {
+					this->direct_send(self);
+				}
+				break;
 			case writing:
 				this->query_write(self, ec);
 				break;
 			case reading:
-				this->query_read(self, ec);
+				// io_engine 关闭或读错误
+				on_query_failure(self, ec ? ec : error::make_error_code(error::pqcpp_ec::NETWORK_ERROR));
 				break;
 			}
 		}
 
+		/**
+		 * @brief io_engine 读入数据后调用, 取出已完整到达的结果
+		 */
+		template <typename Self>
+		void operator()(Self&, input_poll poll) {
+			auto native_conn = m_conn.get_native_conn();
+			if (m_tracer && poll.woke && m_span.first_read == query_span::time_point{}) {
+				m_span.first_read = std::chrono::steady_clock::now();
+			}
+			if (m_tracer && m_span.ready == query_span::time_point{} && PQisBusy(native_conn) == 0) {
+				// 首个结果已完整到达, 此后为取结果(解析)的时间
+				m_span.ready = std::chrono::steady_clock::now();
+				if (m_span.first_read == query_span::time_point{}) {
+					m_span.first_read = m_span.ready;
+				}
+			}
+			while (PQisBusy(native_conn) == 0) {
+				auto pg_res = PQgetResult(native_conn);
+				if (m_pipelined) {
+					// 管道模式下每条查询的结果以 NULL 结束, 随后是本查询的 sync
+					if (!pg_res) {
+						++m_statement;
+						continue;
+					}
+#ifdef LIBPQ_HAS_PIPELINING
+					if (PQresultStatus(pg_res) == PGRES_PIPELINE_SYNC) {
+						PQclear(pg_res);
+						pg_res = nullptr;
+					}
+#endif
+				}
+				if (!pg_res) {
+					*poll.ready = true;
+					return;
+				}
+				m_results.push_back(std::make_shared<result>(pg_res));
+				m_result_statements.push_back(m_statement);
+			}
+		}
+
+		/**
+		 * @brief 已从 io_engine 移除
+		 */
+		template <typename Self>
+		void operator()(Self& self, input_ready) {
+			PQCPP_LOG_DEBUG("connection {} query success", m_conn.id());
+			on_query_complete(self);
+		}
+
+		/**
+		 * @brief 排队期间连接已析构
+		 */
+		template <typename Self>
+		void operator()(Self& self, input_aborted) {
+			self.complete(boost::asio::error::operation_aborted, {});
+		}
+
+		/**
+		 * @brief 交给 io_engine 前放弃对连接的强引用
+		 */
+		std::weak_ptr<const void> release_holder() {
+			std::weak_ptr<const void> owner = m_conn_holder;
+			m_conn_holder.reset();
+			return owner;
+		}
+
+		/**
+		 * @brief 非管道模式发送, 在 strand 上调用
+		 */
+		template <typename Self>
+		void direct_send(Self& self) {
+			auto native_conn = m_conn.get_native_conn();
+			if (!native_conn || m_conn.get_engine().closed()) {
+				on_query_failure(self, error::make_error_code(error::pqcpp_ec::NETWORK_ERROR));
+				return;
+			}
+#ifdef LIBPQ_HAS_PIPELINING
+			// 关闭多路复用后, 空闲时退出管道模式
+			if (PQpipelineStatus(native_conn) != PQ_PIPELINE_OFF) {
+				PQexitPipelineMode(native_conn);
+			}
+#endif
+			if (!this->send_query(*this->m_query)) {
+				PQCPP_LOG_ERROR(
+					"connection {} send query error: {}",
+					m_conn.id(),
+					m_conn.error_message()
+				);
+				this->on_query_failure(self, error::make_error_code(error::pqcpp_ec::QUERY_FAILED));
+				return;
+			}
+			state_ = writing;
+			this->query_write(self);
+		}
+
+		/**
+		 * @brief 管道模式发送: 查询 + sync 写入 libpq 缓冲区, 由 io_engine 负责刷出
+		 */
+		template <typename Self>
+		void pipeline_send(Self& self) {
+#ifdef LIBPQ_HAS_PIPELINING
+			auto native_conn = m_conn.get_native_conn();
+			auto& engine = m_conn.get_engine();
+			if (!native_conn || engine.closed()) {
+				on_query_failure(self, error::make_error_code(error::pqcpp_ec::NETWORK_ERROR));
+				return;
+			}
+			if (PQpipelineStatus(native_conn) == PQ_PIPELINE_OFF && PQenterPipelineMode(native_conn) != 1) {
+				PQCPP_LOG_ERROR("connection {} enter pipeline mode error: {}", m_conn.id(), m_conn.error_message());
+				on_query_failure(self, error::make_error_code(error::pqcpp_ec::QUERY_FAILED));
+				return;
+			}
+			// 管道模式只能使用扩展协议, 无参数时同样走 PQsendQueryParams
+			auto send = [native_conn](const query& q) {
+				return PQsendQueryParams(
+					native_conn,
+					q.command(),
+					q.params_size(),
+					nullptr,
+					q.params_values(),
+					q.params_lengths(),
+					q.params_formats(),
+					q.result_format()
+				) == 1;
+			};
+			bool sent = true;
+			if (m_group.empty()) {
+				sent = send(*m_query);
+			}
+			for (std::size_t i = 0; sent && i < m_group.size(); ++i) {
+				sent = send(*m_group[i]);
+			}
+			if (!sent || PQpipelineSync(native_conn) != 1) {
+				PQCPP_LOG_ERROR("connection {} send query error: {}", m_conn.id(), m_conn.error_message());
+				on_query_failure(self, error::make_error_code(error::pqcpp_ec::QUERY_FAILED));
+				return;
+			}
+			if (!engine.flush()) {
+				PQCPP_LOG_ERROR("connection {} query write error: {}", m_conn.id(), m_conn.error_message());
+				on_query_failure(self, error::make_error_code(error::pqcpp_ec::NETWORK_ERROR));
+				return;
+			}
+			if (m_tracer) {
+				m_span.flushed = std::chrono::steady_clock::now();
+			}
+			state_ = reading;
+			engine.push(std::make_shared<io_engine::op_consumer<Self>>(std::move(self), release_holder()));
+#else
+			PQCPP_LOG_ERROR("connection {} multiplexing requires libpq with pipeline mode", m_conn.id());
+			on_query_failure(self, error::make_error_code(error::pqcpp_ec::QUERY_FAILED));
+#endif
+		}
+
 		template <typename Self>
 		void query_write(Self& self, const error_code& ec = {}) {
 			if (ec) {
-                if(ec == boost::asio::error::operation_aborted){
-                    return;
-                }
-				error_code ignore_ec;
-                m_conn.get_socket().cancel(ignore_ec);
-				logger()->error("connection {} write error {}: {}", m_conn.id(), ec.value(), ec.message());
+				PQCPP_LOG_ERROR("connection {} write error {}: {}", m_conn.id(), ec.value(), ec.message());
 				this->on_query_failure(self, ec);
 				return;
 			}
 			int flush_res = PQflush(m_conn.get_native_conn());
 			if (flush_res == -1) {
-				logger()->error("connection {} query write error: {}", m_conn.id(), m_conn.error_message());
+				PQCPP_LOG_ERROR("connection {} query write error: {}", m_conn.id(), m_conn.error_message());
 				on_query_failure(self, error::make_error_code(error::pqcpp_ec::NETWORK_ERROR));
 				return;
 			}
 			else if (flush_res == 1) {
-				logger()->trace("connection {} query wait write", m_conn.id());
+				PQCPP_LOG_TRACE("connection {} query wait write", m_conn.id());
+				m_waiting = true;
+				m_conn.get_io_stats().add(io_stats::write_arm);
 				m_conn.get_socket().async_wait(socket_type::wait_write, boost::asio::bind_executor(
 					m_conn.get_strand(),
 					std::move(self)
@@ -125,41 +395,16 @@ namespace detail {
 				return;
 			}
 			else if(flush_res == 0) {
+				if (m_tracer) {
+					m_span.flushed = std::chrono::steady_clock::now();
+				}
 				state_ = reading;
-				this->query_read(self);
+				auto& engine = m_conn.get_engine();
+				engine.push(std::make_shared<io_engine::op_consumer<Self>>(std::move(self), release_holder()));
 				return;
 			}
 			return;
 		}
-
-		template <typename Self>
-		void query_read(Self& self, const error_code& ec = {}) {
-			if (ec) {
-                if(ec == boost::asio::error::operation_aborted){
-                    return;
-                }
-				error_code ignore_ec;
-                m_conn.get_socket().cancel(ignore_ec);
-				logger()->error("connection {} read error {}: {}", m_conn.id(), ec.value(), ec.message());
-				on_query_failure(self, ec);
-				return;
-			}
-			if (PQconsumeInput(m_conn.get_native_conn()) == 0) {
-				std::string error = PQerrorMessage(m_conn.get_native_conn());
-				logger()->error("connection {} query read error: {}", m_conn.id(), error);
-				on_query_failure(self ,error::make_error_code(error::pqcpp_ec::QUERY_FAILED));
-				return;
-			}
-			if (PQisBusy(m_conn.get_native_conn()) == 0) {
-				logger()->debug("connection {} query success", m_conn.id());
-				on_query_complete(self);
-                return;
-			}
-			m_conn.get_socket().async_wait(socket_type::wait_read, boost::asio::bind_executor(
-				m_conn.get_strand(),
-				std::move(self)
-			));
-		}
     };
 
 }
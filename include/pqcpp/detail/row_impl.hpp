@@ -21,6 +21,28 @@ namespace pqcpp {
         return m_result->is_null(m_row_num, col_num);
     }
 
+    inline Oid row::col_type(int col_num) const {
+        return m_result->header()->col_type(col_num);
+    }
+
+    template <typename String>
+    inline int row::field_index(const String& field_name) const {
+        return m_result->header()->field_index(field_name);
+    }
+
+    inline field_view row::raw(int col_num) const {
+        if (col_num < 0 || col_num >= m_result->col_count()) {
+            throw std::out_of_range("colume number out of colume count");
+        }
+        field_view f{
+            m_result->get_value(m_row_num, col_num),
+            m_result->get_length(m_row_num, col_num),
+            m_result->header()->col_format(col_num)
+        };
+        f.is_null = this->is_null(col_num);
+        return f;
+    }
+
     template <typename T>
     inline auto row::get(int col_num) const {
         int col_count = m_result->col_count();
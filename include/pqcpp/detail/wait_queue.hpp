@@ -0,0 +1,156 @@
+#pragma once
+
+#include <map>
+#include <queue>
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 等待者调度策略
+	 */
+	enum class waiter_scheduling {
+		// 严格按优先级, 高优先级排空前低优先级不会被服务
+		strict_priority,
+		// 按优先级权重分配, 低优先级也能按比例获得连接
+		weighted_fair
+	};
+
+namespace detail {
+
+	/**
+	 * @brief 连接等待队列
+	 *
+	 * 优先级之间按 strict/weighted 调度(stride), 同一优先级内各租户按权重公平排队(SFQ),
+	 * 全部默认参数时退化为 FIFO
+	 *
+	 * @tparam T 等待项
+	 */
+	template <typename T>
+	class wait_queue {
+		struct entry {
+			double tag;
+			std::size_t seq;
+			std::string tenant;
+			T item;
+		};
+
+		struct entry_greater {
+			bool operator()(const entry& l, const entry& r) const {
+				return l.tag != r.tag ? l.tag > r.tag : l.seq > r.seq;
+			}
+		};
+
+		struct tenant_state {
+			double last_tag{ 0 };
+			std::size_t queued{ 0 };
+		};
+
+		struct class_queue {
+			std::priority_queue<entry, std::vector<entry>, entry_greater> entries;
+			std::map<std::string, tenant_state> tenants;
+			// 租户虚拟时间
+			double vtime{ 0 };
+			// 优先级间 stride 调度的 pass 值
+			double pass{ 0 };
+		};
+
+	public:
+		wait_queue(
+			waiter_scheduling scheduling = waiter_scheduling::weighted_fair,
+			std::vector<double> priority_weights = {},
+			std::map<std::string, double> tenant_weights = {}
+		)
+			:m_scheduling(scheduling),
+			m_priority_weights(std::move(priority_weights)),
+			m_tenant_weights(std::move(tenant_weights))
+		{}
+
+		bool empty() const {
+			return m_size == 0;
+		}
+
+		std::size_t size() const {
+			return m_size;
+		}
+
+		void push(T item, int priority = 0, const std::string& tenant = {}) {
+			auto& cls = m_classes[priority];
+			if (cls.entries.empty()) {
+				// 重新活跃的优先级不能用之前积累的 pass 抢占
+				cls.pass = std::max(cls.pass, m_pass);
+			}
+			auto& ts = cls.tenants[tenant];
+			double tag = std::max(cls.vtime, ts.last_tag) + 1.0 / tenant_weight(tenant);
+			ts.last_tag = tag;
+			++ts.queued;
+			cls.entries.push(entry{ tag, m_seq++, tenant, std::move(item) });
+			++m_size;
+		}
+
+		/**
+		 * @brief 取出下一个等待项, 调用前须保证非空
+		 */
+		T pop() {
+			auto it = select_class();
+			auto& cls = it->second;
+			entry e = std::move(const_cast<entry&>(cls.entries.top()));
+			cls.entries.pop();
+			cls.vtime = e.tag;
+			auto ts = cls.tenants.find(e.tenant);
+			if (--ts->second.queued == 0) {
+				cls.tenants.erase(ts);
+			}
+			m_pass = cls.pass;
+			cls.pass += 1.0 / priority_weight(it->first);
+			if (cls.entries.empty()) {
+				m_classes.erase(it);
+			}
+			--m_size;
+			return std::move(e.item);
+		}
+
+	private:
+		typename std::map<int, class_queue>::iterator select_class() {
+			if (m_scheduling == waiter_scheduling::strict_priority) {
+				return m_classes.begin();
+			}
+			auto best = m_classes.begin();
+			for (auto it = std::next(best); it != m_classes.end(); ++it) {
+				if (it->second.pass < best->second.pass) {
+					best = it;
+				}
+			}
+			return best;
+		}
+
+		double priority_weight(int priority) const {
+			if (m_priority_weights.empty()) {
+				return 1.0;
+			}
+			auto index = std::clamp<std::size_t>(std::max(priority, 0), 0, m_priority_weights.size() - 1);
+			return std::max(m_priority_weights[index], std::numeric_limits<double>::epsilon());
+		}
+
+		double tenant_weight(const std::string& tenant) const {
+			auto it = m_tenant_weights.find(tenant);
+			return it == m_tenant_weights.end()
+				? 1.0
+				: std::max(it->second, std::numeric_limits<double>::epsilon());
+		}
+
+	private:
+		waiter_scheduling m_scheduling;
+		std::vector<double> m_priority_weights;
+		std::map<std::string, double> m_tenant_weights;
+		std::map<int, class_queue> m_classes;
+		double m_pass{ 0 };
+		std::size_t m_seq{ 0 };
+		std::size_t m_size{ 0 };
+	};
+
+}
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <functional>
+#include <boost/asio.hpp>
+#include <pqcpp/coro.hpp>
+#include <pqcpp/error.hpp>
+
+namespace pqcpp {
+namespace detail {
+
+	/**
+	 * @brief 等待某个共享状态变化的协程列表, 由状态所在的 mutex 保护
+	 */
+	class waiter_list {
+	public:
+		void push(std::function<void()> waiter) {
+			m_waiters.push_back(std::move(waiter));
+		}
+
+		/**
+		 * @brief 在锁内取出全部等待者, 释放锁后调用 notify
+		 */
+		std::vector<std::function<void()>> take() {
+			return std::exchange(m_waiters, {});
+		}
+
+		static void notify(std::vector<std::function<void()>> waiters) {
+			for (auto& w : waiters) {
+				w();
+			}
+		}
+
+	private:
+		std::vector<std::function<void()>> m_waiters;
+	};
+
+	/**
+	 * @brief 挂起直到被唤醒或到达 deadline, 条件已成立时立即恢复; 被唤醒时取消超时定时器
+	 */
+	template <typename State, typename Pred>
+	awaitable<void> wait_once(
+		std::shared_ptr<State> s,
+		waiter_list State::* list,
+		Pred pred,
+		std::chrono::steady_clock::time_point deadline,
+		boost::asio::any_io_executor executor
+	) {
+		return boost::asio::async_initiate<decltype(use_awaitable), void()>(
+			[s, list, pred, deadline, executor](auto handler) {
+				// 唤醒与超时只有先到者恢复协程
+				auto h = std::make_shared<decltype(handler)>(std::move(handler));
+				auto fired = std::make_shared<std::atomic_bool>(false);
+				std::shared_ptr<boost::asio::steady_timer> timer;
+				if (deadline != std::chrono::steady_clock::time_point::max()) {
+					timer = std::make_shared<boost::asio::steady_timer>(executor, deadline);
+				}
+				// 只弱引用定时器, 等待列表中的 resume 不延长其生存期
+				auto resume = [h, fired, weak_timer = std::weak_ptr<boost::asio::steady_timer>(timer), executor]() {
+					if (!fired->exchange(true)) {
+						if (auto t = weak_timer.lock()) {
+							boost::asio::post(executor, [t]() {
+								t->cancel();
+							});
+						}
+						auto ex = boost::asio::get_associated_executor(*h);
+						boost::asio::post(ex, std::move(*h));
+					}
+				};
+				// 先启动定时器再登记, 唤醒方投递的 cancel 总在 async_wait 之后
+				if (timer) {
+					timer->async_wait([timer, resume](const error_code&) {
+						resume();
+					});
+				}
+				bool ready;
+				{
+					std::unique_lock lock(s->mutex);
+					ready = pred(*s);
+					if (!ready) {
+						((*s).*list).push(resume);
+					}
+				}
+				if (ready) {
+					resume();
+				}
+			},
+			use_awaitable
+		);
+	}
+
+	/**
+	 * @brief 等待 pred(*s) 成立, 每次被唤醒后在 s->mutex 下重新检查
+	 *
+	 * @param s 含 std::mutex mutex 成员的共享状态
+	 * @param list 状态修改方在修改后取出并唤醒的等待列表
+	 * @param timeout 超时返回 false
+	 */
+	template <typename State, typename Pred>
+	awaitable<bool> wait_until(
+		std::shared_ptr<State> s,
+		waiter_list State::* list,
+		Pred pred,
+		std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max()
+	) {
+		using clock_type = std::chrono::steady_clock;
+		auto deadline = timeout == clock_type::duration::max() ? clock_type::time_point::max() : clock_type::now() + timeout;
+		auto executor = co_await boost::asio::this_coro::executor;
+		for (;;) {
+			{
+				std::unique_lock lock(s->mutex);
+				if (pred(*s)) {
+					co_return true;
+				}
+			}
+			if (clock_type::now() >= deadline) {
+				co_return false;
+			}
+			co_await wait_once(s, list, pred, deadline, executor);
+		}
+	}
+
+}
+}
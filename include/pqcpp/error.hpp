@@ -15,7 +15,8 @@ namespace error {
 		CONNECT_FAILED,
 		QUERY_FAILED,
 		NETWORK_ERROR,
-		INVALID_MIGRATIONS_DIR
+		INVALID_MIGRATIONS_DIR,
+		NO_AVAILABLE_NODE
     };
 
 	class error_category : public boost::system::error_category
@@ -31,6 +32,7 @@ namespace error {
 			case pqcpp_ec::CONNECT_FAILED: return "database connect failed";
 			case pqcpp_ec::QUERY_FAILED: return "query failed";
 			case pqcpp_ec::NETWORK_ERROR: return "network error";
+			case pqcpp_ec::NO_AVAILABLE_NODE: return "no available database node";
 			default:
 				return "";
 			}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <boost/asio.hpp>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 每核一个 io_context, 按轮询分配 executor
+	 *
+	 * 配合 connection_pool_option::connection_executor 把连接分散到多个 io_context 上,
+	 * 每个连接的 I/O 固定在其中一个线程
+	 */
+	class io_context_pool {
+	public:
+		using executor_type = boost::asio::any_io_executor;
+
+		/**
+		 * @param size io_context 数量, 0 为硬件线程数
+		 */
+		explicit io_context_pool(std::size_t size = 0) {
+			if (size == 0) {
+				size = std::max(1u, std::thread::hardware_concurrency());
+			}
+			for (std::size_t i = 0; i < size; ++i) {
+				auto& io = m_contexts.emplace_back(std::make_unique<boost::asio::io_context>(1));
+				m_guards.emplace_back(io->get_executor());
+			}
+		}
+
+		~io_context_pool() {
+			stop();
+			join();
+		}
+
+		io_context_pool(const io_context_pool&) = delete;
+		io_context_pool& operator=(const io_context_pool&) = delete;
+
+		std::size_t size() const {
+			return m_contexts.size();
+		}
+
+		boost::asio::io_context& context(std::size_t index) {
+			return *m_contexts[index];
+		}
+
+		/**
+		 * @brief 轮询取下一个 executor, 线程安全
+		 */
+		executor_type get_executor() {
+			auto index = m_next.fetch_add(1, std::memory_order_relaxed) % m_contexts.size();
+			return m_contexts[index]->get_executor();
+		}
+
+		/**
+		 * @brief 用作 connection_pool_option::connection_executor, 须在连接池销毁前保持存活
+		 */
+		std::function<executor_type()> selector() {
+			return [this]() {
+				return get_executor();
+			};
+		}
+
+		/**
+		 * @brief 每个 io_context 启动一个线程
+		 */
+		void run() {
+			for (auto& io : m_contexts) {
+				m_threads.emplace_back([&io]() {
+					io->run();
+				});
+			}
+		}
+
+		/**
+		 * @brief 移除 work guard, 已有任务完成后线程退出
+		 */
+		void release() {
+			for (auto& guard : m_guards) {
+				guard.reset();
+			}
+		}
+
+		void stop() {
+			for (auto& io : m_contexts) {
+				io->stop();
+			}
+		}
+
+		void join() {
+			for (auto& t : m_threads) {
+				if (t.joinable()) {
+					t.join();
+				}
+			}
+			m_threads.clear();
+		}
+
+	private:
+		std::vector<std::unique_ptr<boost::asio::io_context>> m_contexts;
+		std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_guards;
+		std::vector<std::thread> m_threads;
+		std::atomic_size_t m_next{ 0 };
+	};
+
+}
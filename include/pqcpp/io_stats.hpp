@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 连接 I/O 计数快照
+	 */
+	struct io_counters {
+		std::uint64_t queries{ 0 };
+		// async_wait 完成次数
+		std::uint64_t read_wakeups{ 0 };
+		std::uint64_t write_wakeups{ 0 };
+		// async_wait 发起次数(每次对应一次 reactor 注册)
+		std::uint64_t read_arms{ 0 };
+		std::uint64_t write_arms{ 0 };
+		std::uint64_t consume_calls{ 0 };
+		std::uint64_t cancels{ 0 };
+		// 以下两项仅在开启 io_detail 时统计(每次唤醒额外一次 FIONREAD)
+		std::uint64_t bytes_read{ 0 };
+		// 唤醒时无数据可读
+		std::uint64_t spurious_wakeups{ 0 };
+
+		std::uint64_t wakeups() const {
+			return read_wakeups + write_wakeups;
+		}
+
+		double bytes_per_wakeup() const {
+			return read_wakeups ? static_cast<double>(bytes_read) / read_wakeups : 0;
+		}
+
+		double wakeups_per_query() const {
+			return queries ? static_cast<double>(wakeups()) / queries : 0;
+		}
+
+		/**
+		 * @brief 每查询 reactor 相关调用数(注册 + 取消 + 读取)
+		 */
+		double syscalls_per_query() const {
+			return queries
+				? static_cast<double>(read_arms + write_arms + cancels + consume_calls) / queries
+				: 0;
+		}
+	};
+
+namespace detail {
+
+	/**
+	 * @brief 连接 I/O 计数, 在连接 strand 上写入, 可从任意线程读取快照
+	 */
+	class io_stats {
+	public:
+		enum counter {
+			read_wakeup,
+			write_wakeup,
+			read_arm,
+			write_arm,
+			consume_call,
+			cancel,
+			bytes_read,
+			spurious_wakeup,
+			counter_count
+		};
+
+		void add(counter c, std::uint64_t n = 1) {
+			m_counters[c].fetch_add(n, std::memory_order_relaxed);
+		}
+
+		bool detail_enabled() const {
+			return m_detail.load(std::memory_order_relaxed);
+		}
+
+		void enable_detail(bool enable) {
+			m_detail.store(enable, std::memory_order_relaxed);
+		}
+
+		io_counters snapshot(std::uint64_t queries) const {
+			io_counters c;
+			c.queries = queries;
+			c.read_wakeups = get(read_wakeup);
+			c.write_wakeups = get(write_wakeup);
+			c.read_arms = get(read_arm);
+			c.write_arms = get(write_arm);
+			c.consume_calls = get(consume_call);
+			c.cancels = get(cancel);
+			c.bytes_read = get(bytes_read);
+			c.spurious_wakeups = get(spurious_wakeup);
+			return c;
+		}
+
+		void reset() {
+			for (auto& c : m_counters) {
+				c.store(0, std::memory_order_relaxed);
+			}
+		}
+
+	private:
+		std::uint64_t get(counter c) const {
+			return m_counters[c].load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<std::uint64_t> m_counters[counter_count] = {};
+		std::atomic<bool> m_detail{ false };
+	};
+
+}
+}
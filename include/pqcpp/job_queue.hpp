@@ -0,0 +1,417 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <pqcpp/connection_pool.hpp>
+#include <pqcpp/result.hpp>
+#include <pqcpp/logger.hpp>
+#include <pqcpp/detail/waiter_list.hpp>
+
+namespace pqcpp {
+
+	struct job_queue_option {
+		// 任务表名, 原样拼入 SQL
+		std::string table = "pqcpp_jobs";
+		// 队列名, 同一张表可容纳多个队列
+		std::string queue = "default";
+		// 通知频道, 为空时使用表名
+		std::string channel;
+		// 本进程的消费协程数
+		std::size_t consumers = 1;
+		// 每次出队的最大任务数, 同批任务在一个事务内处理并确认
+		std::size_t batch_size = 32;
+		// 未收到通知时的兜底轮询间隔, 也是监听连接断开后的重连间隔
+		std::chrono::milliseconds poll_interval{ 5000 };
+		// 处理失败后重新可见的延迟
+		std::chrono::milliseconds retry_delay{ 10000 };
+		// 失败达到该次数后不再出队(run_at 置为 infinity), 0 为不限
+		int max_attempts = 5;
+	};
+
+	struct job_queue_stats {
+		std::size_t processed{ 0 };
+		std::size_t failed{ 0 };
+		// 出队事务数(含空批)
+		std::size_t batches{ 0 };
+		std::size_t notifications{ 0 };
+	};
+
+	struct job {
+		std::int64_t id;
+		std::string payload;
+		// 此前失败的次数
+		int attempts;
+	};
+
+	/**
+	 * @brief 基于 FOR UPDATE SKIP LOCKED 的任务队列
+	 *
+	 * 每个消费协程借出连接, 在一个事务内以 SKIP LOCKED 锁定至多 batch_size 个到期任务,
+	 * 依次调用处理函数, 然后用一条语句删除成功的任务并推迟失败的任务, 提交即确认;
+	 * 进程崩溃时事务回滚, 任务自动重新可见. 并发消费者互不阻塞.
+	 * 入队时 pg_notify, 消费者经一条专用的 LISTEN 连接唤醒, 无需轮询;
+	 * 上一批取满时不等待直接取下一批. 表结构见 create_table_command()
+	 *
+	 * @code
+	 * auto queue = job_queue::make(pool, [](const job& j) -> awaitable<void> {
+	 *     co_await send_mail(j.payload);
+	 * });
+	 * co_await queue->enqueue("{\"to\":\"a@b.c\"}");
+	 * ...
+	 * co_await queue->stop();
+	 * @endcode
+	 */
+	class job_queue {
+		struct state {
+			std::mutex mutex;
+			bool stopping{ false };
+			// 每次唤醒加一, 消费者据此判断是否有新任务
+			std::uint64_t generation{ 0 };
+			std::size_t running{ 0 };
+			std::shared_ptr<connection> listener;
+			job_queue_stats stats;
+			detail::waiter_list consumer_waiters;
+			detail::waiter_list stop_waiters;
+		};
+
+		struct commands {
+			std::string dequeue;
+			std::string ack;
+			std::string enqueue;
+			std::string listen;
+		};
+
+	public:
+		using handler_type = std::function<awaitable<void>(const job&)>;
+
+		/**
+		 * @brief 创建队列并启动消费者和监听连接
+		 *
+		 * @param handler 抛出异常视为失败, 任务在 retry_delay 后重试
+		 */
+		static std::shared_ptr<job_queue> make(
+			std::shared_ptr<connection_pool> pool,
+			handler_type handler,
+			job_queue_option opt = {}
+		) {
+			std::shared_ptr<job_queue> queue(new job_queue(std::move(pool), std::move(handler), std::move(opt)));
+			queue->start();
+			return queue;
+		}
+
+		/**
+		 * @brief 只入队不消费
+		 */
+		static std::shared_ptr<job_queue> make_producer(std::shared_ptr<connection_pool> pool, job_queue_option opt = {}) {
+			opt.consumers = 0;
+			return std::shared_ptr<job_queue>(new job_queue(std::move(pool), nullptr, std::move(opt)));
+		}
+
+		/**
+		 * @brief 任务表结构
+		 */
+		static std::string create_table_command(const std::string& table = "pqcpp_jobs") {
+			return fmt::format(
+				"CREATE TABLE IF NOT EXISTS {0} ("
+				"id bigserial PRIMARY KEY, "
+				"queue text NOT NULL, "
+				"payload text NOT NULL, "
+				"run_at timestamptz NOT NULL DEFAULT now(), "
+				"attempts integer NOT NULL DEFAULT 0);"
+				"CREATE INDEX IF NOT EXISTS {0}_dequeue_idx ON {0} (queue, run_at, id);",
+				table
+			);
+		}
+
+		job_queue(const job_queue&) = delete;
+		job_queue& operator=(const job_queue&) = delete;
+
+		/**
+		 * @brief 通知消费者在当前批处理完后退出
+		 */
+		~job_queue() {
+			request_stop();
+		}
+
+		/**
+		 * @brief 入队, 返回任务 id
+		 *
+		 * @param delay 延迟可见的时间
+		 */
+		awaitable<std::int64_t> enqueue(std::string payload, std::chrono::milliseconds delay = {}) {
+			auto conn = co_await m_pool->get(use_awaitable);
+			co_return co_await enqueue(conn, std::move(payload), delay);
+		}
+
+		/**
+		 * @brief 在调用方的连接上入队, 可与业务写入处于同一事务, 通知在提交时送达
+		 */
+		awaitable<std::int64_t> enqueue(std::shared_ptr<connection> conn, std::string payload, std::chrono::milliseconds delay = {}) {
+			auto q = std::make_shared<query>(m_commands.enqueue);
+			q->set_parameters(m_option.queue, payload, static_cast<std::int64_t>(delay.count()), m_option.channel);
+			auto results = co_await conn->async_query(q, use_awaitable);
+			throw_if_error(results);
+			co_return std::stoll(results.front()->get_value(0, 0));
+		}
+
+		/**
+		 * @brief 停止消费并等待处理中的批完成
+		 */
+		awaitable<void> stop() {
+			request_stop();
+			co_await detail::wait_until(m_state, &state::stop_waiters, [](const state& s) {
+				return s.running == 0;
+			});
+		}
+
+		job_queue_stats stats() const {
+			std::unique_lock lock(m_state->mutex);
+			return m_state->stats;
+		}
+
+	private:
+		job_queue(std::shared_ptr<connection_pool> pool, handler_type handler, job_queue_option opt)
+			:m_pool(std::move(pool)), m_handler(std::move(handler)), m_option(std::move(opt)), m_state(std::make_shared<state>())
+		{
+			if (m_option.channel.empty()) {
+				m_option.channel = m_option.table;
+			}
+			m_option.batch_size = std::max<std::size_t>(m_option.batch_size, 1);
+			const auto& t = m_option.table;
+			m_commands.dequeue = fmt::format(
+				"SELECT id, payload, attempts FROM {} WHERE queue = $1 AND run_at <= now() "
+				"ORDER BY run_at, id LIMIT $2 FOR UPDATE SKIP LOCKED;",
+				t
+			);
+			m_commands.ack = fmt::format(
+				"WITH done AS (DELETE FROM {0} WHERE id = ANY($1::bigint[])) "
+				"UPDATE {0} SET attempts = attempts + 1, run_at = CASE WHEN $2::integer > 0 AND attempts + 1 >= $2::integer "
+				"THEN 'infinity'::timestamptz ELSE now() + $3::bigint * interval '1 millisecond' END "
+				"WHERE id = ANY($4::bigint[]);",
+				t
+			);
+			m_commands.enqueue = fmt::format(
+				"WITH j AS (INSERT INTO {} (queue, payload, run_at) VALUES ($1, $2, now() + $3::bigint * interval '1 millisecond') RETURNING id) "
+				"SELECT id, pg_notify($4, $1) FROM j;",
+				t
+			);
+			m_commands.listen = fmt::format("LISTEN \"{}\";", m_option.channel);
+		}
+
+		void start() {
+			if (m_option.consumers == 0 || !m_handler) {
+				return;
+			}
+			m_state->running = m_option.consumers;
+			auto executor = m_pool->get_executor();
+			co_spawn(executor, listener(m_pool, m_state, m_commands, m_option), detached);
+			for (std::size_t i = 0; i < m_option.consumers; ++i) {
+				co_spawn(executor, consumer(m_pool, m_state, m_commands, m_option, m_handler), detached);
+			}
+		}
+
+		void request_stop() {
+			std::shared_ptr<connection> listener;
+			std::vector<std::function<void()>> waiters;
+			{
+				std::unique_lock lock(m_state->mutex);
+				m_state->stopping = true;
+				listener = std::move(m_state->listener);
+				waiters = m_state->consumer_waiters.take();
+			}
+			detail::waiter_list::notify(std::move(waiters));
+			if (listener) {
+				boost::asio::post(listener->get_strand(), [listener]() {
+					listener->disconnect();
+				});
+			}
+		}
+
+		static void wake(const std::shared_ptr<state>& s, bool notified) {
+			std::vector<std::function<void()>> waiters;
+			{
+				std::unique_lock lock(s->mutex);
+				++s->generation;
+				if (notified) {
+					++s->stats.notifications;
+				}
+				waiters = s->consumer_waiters.take();
+			}
+			detail::waiter_list::notify(std::move(waiters));
+		}
+
+		static bool stopping(const std::shared_ptr<state>& s) {
+			std::unique_lock lock(s->mutex);
+			return s->stopping;
+		}
+
+		/**
+		 * @brief 专用 LISTEN 连接, 断开后重连; 重连成功时唤醒消费者以处理断线期间入队的任务
+		 */
+		static awaitable<void> listener(
+			std::shared_ptr<connection_pool> pool,
+			std::shared_ptr<state> s,
+			commands cmds,
+			job_queue_option opt
+		) {
+			auto executor = co_await this_coro::executor;
+			auto listen = std::make_shared<query>(cmds.listen);
+			while (!stopping(s)) {
+				auto conn = connection::make(pool->get_conn_str(), executor);
+				bool listening = false;
+				try {
+					co_await conn->async_connect(use_awaitable);
+					conn->set_notification_handler([s, queue = opt.queue](const PGnotify& notify) {
+						if (queue == notify.extra) {
+							wake(s, true);
+						}
+					});
+					throw_if_error(co_await conn->async_query(listen, use_awaitable));
+					listening = true;
+				}
+				catch (const std::exception& ex) {
+					PQCPP_LOG_WARN("job queue {} listen error: {}", opt.queue, ex.what());
+				}
+				if (listening) {
+					{
+						std::unique_lock lock(s->mutex);
+						if (s->stopping) {
+							break;
+						}
+						s->listener = conn;
+					}
+					wake(s, false);
+					while (conn->is_ready() && !stopping(s)) {
+						co_await detail::delay(executor, opt.poll_interval);
+					}
+					PQCPP_LOG_DEBUG("job queue {} listener closed", opt.queue);
+				}
+				else {
+					co_await detail::delay(executor, opt.poll_interval);
+				}
+			}
+		}
+
+		static awaitable<void> consumer(
+			std::shared_ptr<connection_pool> pool,
+			std::shared_ptr<state> s,
+			commands cmds,
+			job_queue_option opt,
+			handler_type handler
+		) {
+			auto executor = co_await this_coro::executor;
+			std::uint64_t seen = 0;
+			// 上一批取满, 可能还有到期任务
+			bool more = true;
+			for (;;) {
+				if (!more) {
+					co_await detail::wait_until(s, &state::consumer_waiters, [seen](const state& s) {
+						return s.stopping || s.generation != seen;
+					}, opt.poll_interval);
+				}
+				{
+					std::unique_lock lock(s->mutex);
+					if (s->stopping) {
+						break;
+					}
+					seen = s->generation;
+				}
+				bool failed = false;
+				try {
+					auto n = co_await process_batch(pool, s, cmds, opt, handler);
+					more = n == opt.batch_size;
+				}
+				catch (const std::exception& ex) {
+					PQCPP_LOG_ERROR("job queue {} dequeue error: {}", opt.queue, ex.what());
+					failed = true;
+				}
+				if (failed) {
+					more = false;
+					co_await detail::delay(executor, opt.poll_interval);
+				}
+			}
+			std::vector<std::function<void()>> waiters;
+			{
+				std::unique_lock lock(s->mutex);
+				--s->running;
+				waiters = s->stop_waiters.take();
+			}
+			detail::waiter_list::notify(std::move(waiters));
+		}
+
+		/**
+		 * @brief 在一个事务内出队, 处理并确认一批任务
+		 *
+		 * @return std::size_t 本批任务数
+		 */
+		static awaitable<std::size_t> process_batch(
+			std::shared_ptr<connection_pool> pool,
+			std::shared_ptr<state> s,
+			const commands& cmds,
+			const job_queue_option& opt,
+			const handler_type& handler
+		) {
+			auto conn = co_await pool->get(use_awaitable);
+			std::size_t done_count = 0;
+			std::size_t failed_count = 0;
+			auto n = co_await conn->transaction(transaction::READ_COMMITTED, [&]() -> awaitable<std::size_t> {
+				auto dequeue = std::make_shared<query>(cmds.dequeue);
+				dequeue->set_parameters(opt.queue, static_cast<std::int64_t>(opt.batch_size));
+				auto results = co_await conn->async_query(dequeue, use_awaitable);
+				throw_if_error(results);
+				const auto& res = results.front();
+				std::vector<std::int64_t> done;
+				std::vector<std::int64_t> failed;
+				for (int i = 0; i < res->row_count(); ++i) {
+					job j{
+						std::stoll(res->get_value(i, 0)),
+						std::string(res->get_value(i, 1), res->get_length(i, 1)),
+						std::atoi(res->get_value(i, 2))
+					};
+					bool ok = false;
+					try {
+						co_await handler(j);
+						ok = true;
+					}
+					catch (const std::exception& ex) {
+						PQCPP_LOG_WARN("job {} of queue {} failed (attempt {}): {}", j.id, opt.queue, j.attempts + 1, ex.what());
+					}
+					(ok ? done : failed).push_back(j.id);
+				}
+				if (!done.empty() || !failed.empty()) {
+					auto ack = std::make_shared<query>(cmds.ack);
+					ack->set_parameters(
+						fmt::format("{{{}}}", fmt::join(done, ",")),
+						opt.max_attempts,
+						static_cast<std::int64_t>(opt.retry_delay.count()),
+						fmt::format("{{{}}}", fmt::join(failed, ","))
+					);
+					throw_if_error(co_await conn->async_query(ack, use_awaitable));
+				}
+				done_count = done.size();
+				failed_count = failed.size();
+				co_return static_cast<std::size_t>(res->row_count());
+			});
+			std::unique_lock lock(s->mutex);
+			s->stats.processed += done_count;
+			s->stats.failed += failed_count;
+			++s->stats.batches;
+			co_return n;
+		}
+
+	private:
+		std::shared_ptr<connection_pool> m_pool;
+		handler_type m_handler;
+		job_queue_option m_option;
+		commands m_commands;
+		std::shared_ptr<state> m_state;
+	};
+
+}
@@ -2,6 +2,8 @@
 #include <memory>
 #include <filesystem>
 #include <mutex>
+#include <atomic>
+#include <list>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
@@ -31,20 +33,89 @@ namespace pqcpp {
 		return logger;
 	}
 
-	inline std::mutex _global_logger_mutex;
+	namespace detail {
+		inline std::mutex _global_logger_mutex;
+		// 设置过的 logger 全部保留, 其他线程拿到的引用/裸指针始终有效
+		inline std::list<std::shared_ptr<spdlog::logger>> _global_loggers;
+		inline std::atomic<const std::shared_ptr<spdlog::logger>*> _global_logger{ nullptr };
 
-	inline std::shared_ptr<spdlog::logger> _global_logger;
+		inline const std::shared_ptr<spdlog::logger>& init_logger() {
+			std::unique_lock<std::mutex> lock(_global_logger_mutex);
+			if (auto current = _global_logger.load(std::memory_order_acquire)) {
+				return *current;
+			}
+			auto& l = _global_loggers.emplace_back(make_default_logger());
+			_global_logger.store(&l, std::memory_order_release);
+			return l;
+		}
+	}
 
-	inline std::shared_ptr<spdlog::logger> logger() {
-		std::unique_lock<std::mutex> lock(_global_logger_mutex);
-		if(!_global_logger){
-			_global_logger = make_default_logger();
+	/**
+	 * @brief 获取全局 logger, 初始化后无锁且不增加引用计数
+	 */
+	inline const std::shared_ptr<spdlog::logger>& logger() {
+		if (auto current = detail::_global_logger.load(std::memory_order_acquire)) {
+			return *current;
 		}
-		return _global_logger;
+		return detail::init_logger();
 	}
 
 	inline void set_logger(std::shared_ptr<spdlog::logger> new_logger) {
-		_global_logger = new_logger;
+		std::unique_lock<std::mutex> lock(detail::_global_logger_mutex);
+		auto& l = detail::_global_loggers.emplace_back(std::move(new_logger));
+		detail::_global_logger.store(&l, std::memory_order_release);
 	}
-
 };
+
+#define PQCPP_LOG_LEVEL_TRACE 0
+#define PQCPP_LOG_LEVEL_DEBUG 1
+#define PQCPP_LOG_LEVEL_INFO 2
+#define PQCPP_LOG_LEVEL_WARN 3
+#define PQCPP_LOG_LEVEL_ERROR 4
+#define PQCPP_LOG_LEVEL_OFF 6
+
+/**
+ * 编译期日志级别, 低于该级别的 PQCPP_LOG_XXX 展开为空;
+ * 运行期被 logger 级别过滤的日志不会求值和格式化参数
+ */
+#ifndef PQCPP_LOG_ACTIVE_LEVEL
+#define PQCPP_LOG_ACTIVE_LEVEL PQCPP_LOG_LEVEL_TRACE
+#endif
+
+#define PQCPP_LOG(level, ...) \
+	do { \
+		auto& _pqcpp_logger = ::pqcpp::logger(); \
+		if (_pqcpp_logger->should_log(level)) { \
+			_pqcpp_logger->log(level, __VA_ARGS__); \
+		} \
+	} while (0)
+
+#if PQCPP_LOG_ACTIVE_LEVEL <= PQCPP_LOG_LEVEL_TRACE
+#define PQCPP_LOG_TRACE(...) PQCPP_LOG(spdlog::level::trace, __VA_ARGS__)
+#else
+#define PQCPP_LOG_TRACE(...) (void)0
+#endif
+
+#if PQCPP_LOG_ACTIVE_LEVEL <= PQCPP_LOG_LEVEL_DEBUG
+#define PQCPP_LOG_DEBUG(...) PQCPP_LOG(spdlog::level::debug, __VA_ARGS__)
+#else
+#define PQCPP_LOG_DEBUG(...) (void)0
+#endif
+
+#if PQCPP_LOG_ACTIVE_LEVEL <= PQCPP_LOG_LEVEL_INFO
+#define PQCPP_LOG_INFO(...) PQCPP_LOG(spdlog::level::info, __VA_ARGS__)
+#else
+#define PQCPP_LOG_INFO(...) (void)0
+#endif
+
+#if PQCPP_LOG_ACTIVE_LEVEL <= PQCPP_LOG_LEVEL_WARN
+#define PQCPP_LOG_WARN(...) PQCPP_LOG(spdlog::level::warn, __VA_ARGS__)
+#else
+#define PQCPP_LOG_WARN(...) (void)0
+#endif
+
+#if PQCPP_LOG_ACTIVE_LEVEL <= PQCPP_LOG_LEVEL_ERROR
+#define PQCPP_LOG_ERROR(...) PQCPP_LOG(spdlog::level::err, __VA_ARGS__)
+#else
+#define PQCPP_LOG_ERROR(...) (void)0
+#endif
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <pqcpp/connection.hpp>
+#include <pqcpp/cursor.hpp>
+#include <pqcpp/row.hpp>
+#include <pqcpp/detail/fan_out.hpp>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 多路有序结果的流式 k 路归并
+	 *
+	 * 每个来源在自己的连接上开启 REPEATABLE READ READ ONLY 事务并声明服务端游标,
+	 * 各游标并发预取, 按 less 逐行归并输出. 各来源的查询须已按同一顺序 ORDER BY.
+	 * 使用完毕须 co_await close() 结束各连接上的事务
+	 *
+	 * @code
+	 * auto m = co_await merge_cursor::open(sources, [](const row& a, const row& b) {
+	 *     return a.get<int64_t>(0) < b.get<int64_t>(0);
+	 * });
+	 * while (auto r = co_await m->next()) { ... }
+	 * co_await m->close();
+	 * @endcode
+	 */
+	class merge_cursor {
+	public:
+		using compare_type = std::function<bool(const row&, const row&)>;
+
+		struct source {
+			std::shared_ptr<connection> conn;
+			std::shared_ptr<query> q;
+		};
+
+		static awaitable<std::shared_ptr<merge_cursor>> open(
+			std::vector<source> sources,
+			compare_type less,
+			cursor_option opt = {}
+		) {
+			std::shared_ptr<merge_cursor> m(new merge_cursor(std::move(less)));
+			if (sources.empty()) {
+				co_return m;
+			}
+			m->m_executor = sources.front().conn->get_executor();
+			m->m_inputs.resize(sources.size());
+			std::vector<std::function<awaitable<bool>()>> tasks;
+			for (std::size_t i = 0; i < sources.size(); ++i) {
+				m->m_inputs[i].conn = sources[i].conn;
+				tasks.push_back([m, i, q = sources[i].q, opt]() {
+					return open_input(m, i, q, opt);
+				});
+			}
+			std::exception_ptr error;
+			try {
+				co_await detail::fan_out(m->m_executor, std::move(tasks));
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			if (error) {
+				co_await m->close();
+				std::rethrow_exception(error);
+			}
+			for (std::size_t i = 0; i < m->m_inputs.size(); ++i) {
+				if (m->m_inputs[i].current) {
+					m->m_heap.push_back(i);
+				}
+			}
+			std::make_heap(m->m_heap.begin(), m->m_heap.end(), m->heap_compare());
+			co_return m;
+		}
+
+		merge_cursor(const merge_cursor&) = delete;
+		merge_cursor& operator=(const merge_cursor&) = delete;
+
+		/**
+		 * @brief 取下一行, 全部来源读完时为空
+		 */
+		awaitable<std::optional<row>> next() {
+			if (m_heap.empty()) {
+				co_return std::nullopt;
+			}
+			std::pop_heap(m_heap.begin(), m_heap.end(), heap_compare());
+			auto index = m_heap.back();
+			m_heap.pop_back();
+			auto out = std::move(*m_inputs[index].current);
+			co_await advance(m_inputs[index]);
+			if (m_inputs[index].current) {
+				m_heap.push_back(index);
+				std::push_heap(m_heap.begin(), m_heap.end(), heap_compare());
+			}
+			co_return out;
+		}
+
+		/**
+		 * @brief 关闭各游标并结束事务, 可重复调用
+		 */
+		awaitable<void> close() {
+			m_heap.clear();
+			std::vector<std::function<awaitable<bool>()>> tasks;
+			for (auto& input : m_inputs) {
+				if (!input.conn) {
+					continue;
+				}
+				tasks.push_back([conn = std::move(input.conn), c = std::move(input.cur)]() {
+					return detail::close_read_only_cursor(conn, c);
+				});
+				input.current.reset();
+				input.batch.reset();
+			}
+			if (!tasks.empty()) {
+				co_await detail::fan_out(m_executor, std::move(tasks));
+			}
+		}
+
+	private:
+		struct input {
+			std::shared_ptr<connection> conn;
+			std::shared_ptr<cursor> cur;
+			std::shared_ptr<result> batch;
+			int index{ 0 };
+			std::optional<row> current;
+		};
+
+		explicit merge_cursor(compare_type less)
+			:m_less(std::move(less))
+		{}
+
+		/**
+		 * @brief 堆顶为当前最小行
+		 */
+		struct heap_less {
+			merge_cursor* self;
+
+			bool operator()(std::size_t a, std::size_t b) const {
+				return self->m_less(*self->m_inputs[b].current, *self->m_inputs[a].current);
+			}
+		};
+
+		heap_less heap_compare() {
+			return { this };
+		}
+
+		static awaitable<bool> open_input(
+			std::shared_ptr<merge_cursor> m,
+			std::size_t i,
+			std::shared_ptr<query> q,
+			cursor_option opt
+		) {
+			auto& in = m->m_inputs[i];
+			in.cur = co_await detail::open_read_only_cursor(in.conn, q, transaction::REPEATABLE_READ, opt);
+			co_await advance(in);
+			co_return true;
+		}
+
+		static awaitable<void> advance(input& in) {
+			if (in.batch && ++in.index < in.batch->row_count()) {
+				in.current.emplace(in.batch, in.index);
+				co_return;
+			}
+			in.current.reset();
+			in.batch = co_await in.cur->next();
+			in.index = 0;
+			if (in.batch) {
+				in.current.emplace(in.batch, 0);
+			}
+		}
+
+	private:
+		compare_type m_less;
+		boost::asio::any_io_executor m_executor;
+		std::vector<input> m_inputs;
+		std::vector<std::size_t> m_heap;
+	};
+
+}
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+#include <fmt/format.h>
+
+namespace pqcpp {
+namespace metrics {
+
+	using labels = std::vector<std::pair<std::string, std::string>>;
+
+	enum class metric_type {
+		counter,
+		gauge,
+		histogram
+	};
+
+	/**
+	 * @brief 指标基类, 由 registry 持有并串成无锁单链表
+	 */
+	class metric {
+		friend class registry;
+	public:
+		metric(std::string name, std::string help, metrics::labels labels)
+			:m_name(std::move(name)), m_help(std::move(help)), m_labels(std::move(labels))
+		{}
+
+		virtual ~metric() {}
+
+		virtual metric_type type() const = 0;
+
+		const std::string& name() const {
+			return m_name;
+		}
+
+		const std::string& help() const {
+			return m_help;
+		}
+
+		const metrics::labels& labels() const {
+			return m_labels;
+		}
+
+		/**
+		 * @brief 追加 Prometheus 文本格式样本行(不含 HELP/TYPE)
+		 */
+		virtual void write(std::string& out) const = 0;
+
+	protected:
+		std::string label_str(const char* extra_key = nullptr, const std::string& extra_value = {}) const {
+			if (m_labels.empty() && !extra_key) {
+				return {};
+			}
+			std::string s = "{";
+			for (const auto& [k, v] : m_labels) {
+				if (s.size() > 1) {
+					s += ',';
+				}
+				s += fmt::format("{}=\"{}\"", k, escape(v));
+			}
+			if (extra_key) {
+				if (s.size() > 1) {
+					s += ',';
+				}
+				s += fmt::format("{}=\"{}\"", extra_key, extra_value);
+			}
+			s += '}';
+			return s;
+		}
+
+		static std::string escape(const std::string& v) {
+			std::string r;
+			r.reserve(v.size());
+			for (char c : v) {
+				switch (c) {
+				case '\\': r += "\\\\"; break;
+				case '"': r += "\\\""; break;
+				case '\n': r += "\\n"; break;
+				default: r += c;
+				}
+			}
+			return r;
+		}
+
+	private:
+		std::string m_name;
+		std::string m_help;
+		metrics::labels m_labels;
+		metric* m_next{ nullptr };
+	};
+
+	class counter : public metric {
+	public:
+		using metric::metric;
+
+		metric_type type() const override {
+			return metric_type::counter;
+		}
+
+		void inc(std::uint64_t n = 1) {
+			m_value.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		std::uint64_t value() const {
+			return m_value.load(std::memory_order_relaxed);
+		}
+
+		void write(std::string& out) const override {
+			out += fmt::format("{}{} {}\n", name(), label_str(), value());
+		}
+
+	private:
+		std::atomic<std::uint64_t> m_value{ 0 };
+	};
+
+	class gauge : public metric {
+	public:
+		using metric::metric;
+
+		metric_type type() const override {
+			return metric_type::gauge;
+		}
+
+		void set(std::int64_t v) {
+			m_value.store(v, std::memory_order_relaxed);
+		}
+
+		void add(std::int64_t n) {
+			m_value.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		std::int64_t value() const {
+			return m_value.load(std::memory_order_relaxed);
+		}
+
+		void write(std::string& out) const override {
+			out += fmt::format("{}{} {}\n", name(), label_str(), value());
+		}
+
+	private:
+		std::atomic<std::int64_t> m_value{ 0 };
+	};
+
+	/**
+	 * @brief 固定桶直方图
+	 */
+	class histogram : public metric {
+	public:
+		histogram(std::string name, std::string help, metrics::labels labels, std::vector<double> bounds)
+			:metric(std::move(name), std::move(help), std::move(labels)),
+			m_bounds(std::move(bounds)),
+			m_buckets(new std::atomic<std::uint64_t>[m_bounds.size() + 1])
+		{
+			std::sort(m_bounds.begin(), m_bounds.end());
+			for (std::size_t i = 0; i <= m_bounds.size(); ++i) {
+				m_buckets[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		metric_type type() const override {
+			return metric_type::histogram;
+		}
+
+		void observe(double v) {
+			auto index = std::lower_bound(m_bounds.begin(), m_bounds.end(), v) - m_bounds.begin();
+			m_buckets[index].fetch_add(1, std::memory_order_relaxed);
+			m_count.fetch_add(1, std::memory_order_relaxed);
+			double sum = m_sum.load(std::memory_order_relaxed);
+			while (!m_sum.compare_exchange_weak(sum, sum + v, std::memory_order_relaxed)) {}
+		}
+
+		std::uint64_t count() const {
+			return m_count.load(std::memory_order_relaxed);
+		}
+
+		double sum() const {
+			return m_sum.load(std::memory_order_relaxed);
+		}
+
+		void write(std::string& out) const override {
+			std::uint64_t cumulative = 0;
+			for (std::size_t i = 0; i < m_bounds.size(); ++i) {
+				cumulative += m_buckets[i].load(std::memory_order_relaxed);
+				out += fmt::format("{}_bucket{} {}\n", name(), label_str("le", fmt::format("{}", m_bounds[i])), cumulative);
+			}
+			cumulative += m_buckets[m_bounds.size()].load(std::memory_order_relaxed);
+			out += fmt::format("{}_bucket{} {}\n", name(), label_str("le", "+Inf"), cumulative);
+			out += fmt::format("{}_sum{} {}\n", name(), label_str(), sum());
+			out += fmt::format("{}_count{} {}\n", name(), label_str(), cumulative);
+		}
+
+	private:
+		std::vector<double> m_bounds;
+		std::unique_ptr<std::atomic<std::uint64_t>[]> m_buckets;
+		std::atomic<std::uint64_t> m_count{ 0 };
+		std::atomic<double> m_sum{ 0 };
+	};
+
+	/**
+	 * @brief 延迟类直方图默认桶(秒)
+	 */
+	inline std::vector<double> latency_buckets() {
+		return { 0.0001, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+	}
+
+	/**
+	 * @brief 指标注册表
+	 *
+	 * 注册为无锁头插, 同名同标签重复注册返回已有指标; 指标生命周期与注册表相同,
+	 * 记录数据只涉及 relaxed 原子操作
+	 */
+	class registry {
+	public:
+		registry() = default;
+		registry(const registry&) = delete;
+		registry& operator=(const registry&) = delete;
+
+		~registry() {
+			auto node = m_head.load();
+			while (node) {
+				auto next = node->m_next;
+				delete node;
+				node = next;
+			}
+		}
+
+		static registry& global() {
+			static registry instance;
+			return instance;
+		}
+
+		counter& make_counter(std::string name, std::string help, metrics::labels labels = {}) {
+			return add(std::make_unique<counter>(std::move(name), std::move(help), std::move(labels)));
+		}
+
+		gauge& make_gauge(std::string name, std::string help, metrics::labels labels = {}) {
+			return add(std::make_unique<gauge>(std::move(name), std::move(help), std::move(labels)));
+		}
+
+		histogram& make_histogram(
+			std::string name,
+			std::string help,
+			metrics::labels labels = {},
+			std::vector<double> bounds = latency_buckets()
+		) {
+			return add(std::make_unique<histogram>(std::move(name), std::move(help), std::move(labels), std::move(bounds)));
+		}
+
+		/**
+		 * @brief 导出 Prometheus 文本格式快照
+		 */
+		std::string prometheus_text() const {
+			std::vector<const metric*> all;
+			for (auto node = m_head.load(std::memory_order_acquire); node; node = node->m_next) {
+				all.push_back(node);
+			}
+			// 头插得到的是逆序, 恢复注册顺序后按名称稳定分组
+			std::reverse(all.begin(), all.end());
+			std::stable_sort(all.begin(), all.end(), [](const metric* l, const metric* r) {
+				return l->name() < r->name();
+			});
+			std::string out;
+			const std::string* family = nullptr;
+			for (auto m : all) {
+				if (!family || *family != m->name()) {
+					family = &m->name();
+					out += fmt::format("# HELP {} {}\n# TYPE {} {}\n", m->name(), m->help(), m->name(), type_name(m->type()));
+				}
+				m->write(out);
+			}
+			return out;
+		}
+
+	private:
+		template <typename M>
+		M& add(std::unique_ptr<M> candidate) {
+			auto head = m_head.load(std::memory_order_acquire);
+			while (true) {
+				for (auto node = head; node; node = node->m_next) {
+					if (node->name() == candidate->name() && node->labels() == candidate->labels()) {
+						if (auto existing = dynamic_cast<M*>(node)) {
+							return *existing;
+						}
+					}
+				}
+				candidate->m_next = head;
+				if (m_head.compare_exchange_weak(head, candidate.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+					return *candidate.release();
+				}
+			}
+		}
+
+		static const char* type_name(metric_type type) {
+			switch (type) {
+			case metric_type::counter: return "counter";
+			case metric_type::gauge: return "gauge";
+			case metric_type::histogram: return "histogram";
+			default: return "untyped";
+			}
+		}
+
+	private:
+		std::atomic<metric*> m_head{ nullptr };
+	};
+
+	/**
+	 * @brief 全局注册表 Prometheus 文本快照
+	 */
+	inline std::string prometheus_text() {
+		return registry::global().prometheus_text();
+	}
+
+}
+}
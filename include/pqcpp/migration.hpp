@@ -80,7 +80,7 @@ public:
 			while (begin != m_migrations.end())
 			{
 				const auto& r = begin->second;
-				logger()->info("run migration: version={}, name={}", r.version, r.name);
+				PQCPP_LOG_INFO("run migration: version={}, name={}", r.version, r.name);
 				auto cmd = this->read_file(r.file);
 				auto migrate_results = co_await conn->async_query(cmd);
 				ensure_success(migrate_results);
@@ -89,7 +89,7 @@ public:
 					r.version, r.name
 				);
 				ensure_success(save_migration_results);
-				logger()->info("migrate {} success", r.file.filename().string());
+				PQCPP_LOG_INFO("migrate {} success", r.file.filename().string());
 				++begin;
 			}
 		});
@@ -103,7 +103,7 @@ private:
 					return true;
 				}
 				else {
-					logger()->error("{}", result->error_message());
+					PQCPP_LOG_ERROR("{}", result->error_message());
 					return false;
 				}
 			});
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <functional>
+#include <pqcpp/connection_pool.hpp>
+#include <pqcpp/cursor.hpp>
+#include <pqcpp/snapshot.hpp>
+#include <pqcpp/detail/fan_out.hpp>
+
+namespace pqcpp {
+
+	struct parallel_scan_option {
+		// 键范围 [begin, end)
+		std::int64_t begin = 0;
+		std::int64_t end = 0;
+		// 分区数, 0 或超出连接池当前并发限制(concurrency_limit(), 未开启自适应限制时为 max_size)时取该限制(自行导出快照时再减一)
+		std::size_t partitions = 0;
+		// 按分区顺序(即键顺序)输出, 此时后续分区只预取一批; 否则优先输出已就绪分区的批
+		bool ordered = false;
+		cursor_option cursor;
+		// 各分区导入同一个导出快照, 看到同一时间点的数据; 协调事务额外占用一个连接
+		bool consistent = false;
+		// 使用已有的导出快照(隐含 consistent), 由调用方负责 release()
+		std::shared_ptr<exported_snapshot> snapshot;
+	};
+
+	/**
+	 * @brief 按键范围分区的并行扫描
+	 *
+	 * 把 [begin, end) 均分为 K 段, 每段在一个借出的连接上以只读事务 + 服务端游标读取,
+	 * 各分区并发预取, next() 逐批输出. 查询以 $1/$2 接收分段的下界(含)/上界(不含):
+	 *
+	 * @code
+	 * auto q = std::make_shared<query>("SELECT * FROM events WHERE id >= $1 AND id < $2");
+	 * parallel_scan_option opt{ 0, max_id + 1, 8 };
+	 * auto scan = co_await parallel_scan::open(pool, q, opt);
+	 * while (auto batch = co_await scan->next()) { ... }
+	 * co_await scan->close();
+	 * @endcode
+	 *
+	 * 开启 consistent 时, 先在一个连接上导出快照, 各分区以 SET TRANSACTION SNAPSHOT 导入后
+	 * 释放协调连接, 大表导出跨多个后端并行进行且仍是同一时间点的一致视图.
+	 * 使用完毕须 co_await close() 结束各连接上的事务
+	 */
+	class parallel_scan {
+	public:
+		static awaitable<std::shared_ptr<parallel_scan>> open(
+			std::shared_ptr<connection_pool> pool,
+			std::shared_ptr<query> q,
+			parallel_scan_option opt
+		) {
+			if (opt.end < opt.begin) {
+				throw std::invalid_argument("parallel_scan range end < begin");
+			}
+			std::shared_ptr<parallel_scan> scan(new parallel_scan(pool->get_executor(), opt.ordered));
+			auto span = static_cast<std::uint64_t>(opt.end) - static_cast<std::uint64_t>(opt.begin);
+			auto snapshot = opt.snapshot;
+			bool own_snapshot = opt.consistent && !snapshot;
+			if (own_snapshot && pool->concurrency_limit() < 2) {
+				throw std::invalid_argument("consistent parallel_scan requires a pool concurrency limit of at least 2");
+			}
+			// 每个分区占用一个连接直到 close(), 协调事务再占用一个; 超出可借出的连接数(自适应并发限制或
+			// max_size)时后开的分区永远等不到连接
+			auto max_parts = static_cast<std::uint64_t>(std::max(pool->concurrency_limit() - (own_snapshot ? 1 : 0), 1));
+			std::uint64_t k = opt.partitions ? std::min<std::uint64_t>(opt.partitions, max_parts) : max_parts;
+			k = std::max<std::uint64_t>(std::min(k, span), 1);
+			scan->m_parts.resize(k);
+			if (own_snapshot) {
+				snapshot = co_await exported_snapshot::open(pool);
+			}
+			std::vector<std::function<awaitable<bool>()>> tasks;
+			auto lower = opt.begin;
+			for (std::uint64_t i = 0; i < k; ++i) {
+				// 余数分摊到前几段
+				auto size = span / k + (i < span % k ? 1 : 0);
+				auto upper = static_cast<std::int64_t>(static_cast<std::uint64_t>(lower) + size);
+				auto sub = q->with_command(q->command());
+				sub->set_parameters(lower, upper);
+				tasks.push_back([scan, pool, i, sub, opt, snapshot]() {
+					return open_partition(scan, pool, i, sub, opt.cursor, snapshot);
+				});
+				lower = upper;
+			}
+			std::exception_ptr error;
+			try {
+				co_await detail::fan_out(scan->m_executor, std::move(tasks));
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			if (own_snapshot) {
+				co_await snapshot->release();
+			}
+			if (error) {
+				co_await scan->close();
+				std::rethrow_exception(error);
+			}
+			co_return scan;
+		}
+
+		parallel_scan(const parallel_scan&) = delete;
+		parallel_scan& operator=(const parallel_scan&) = delete;
+
+		/**
+		 * @brief 取下一批, 全部分区读完时为 nullptr
+		 */
+		awaitable<std::shared_ptr<result>> next() {
+			while (auto index = pick()) {
+				auto& part = m_parts[*index];
+				auto batch = co_await part.cur->next();
+				if (batch) {
+					m_next = *index + (m_ordered ? 0 : 1);
+					co_return batch;
+				}
+				part.done = true;
+			}
+			co_return nullptr;
+		}
+
+		/**
+		 * @brief 关闭各分区游标并结束事务, 可重复调用
+		 */
+		awaitable<void> close() {
+			std::vector<std::function<awaitable<bool>()>> tasks;
+			for (auto& part : m_parts) {
+				if (!part.conn) {
+					continue;
+				}
+				tasks.push_back([conn = std::move(part.conn), c = std::move(part.cur)]() {
+					return detail::close_read_only_cursor(conn, c);
+				});
+				part.done = true;
+			}
+			if (!tasks.empty()) {
+				co_await detail::fan_out(m_executor, std::move(tasks));
+			}
+		}
+
+		std::size_t partitions() const {
+			return m_parts.size();
+		}
+
+	private:
+		struct partition {
+			std::shared_ptr<connection> conn;
+			std::shared_ptr<cursor> cur;
+			bool done{ false };
+		};
+
+		parallel_scan(boost::asio::any_io_executor executor, bool ordered)
+			:m_executor(std::move(executor)), m_ordered(ordered)
+		{}
+
+		static awaitable<bool> open_partition(
+			std::shared_ptr<parallel_scan> scan,
+			std::shared_ptr<connection_pool> pool,
+			std::size_t i,
+			std::shared_ptr<query> q,
+			cursor_option opt,
+			std::shared_ptr<exported_snapshot> snapshot
+		) {
+			auto& part = scan->m_parts[i];
+			part.conn = co_await pool->get(use_awaitable);
+			if (snapshot) {
+				co_await snapshot->import(part.conn);
+				part.cur = co_await cursor::open(part.conn, q, opt);
+			}
+			else {
+				part.cur = co_await detail::open_read_only_cursor(part.conn, q, transaction::READ_COMMITTED, opt);
+			}
+			co_return true;
+		}
+
+		/**
+		 * @brief 选择下一个读取的分区: 有序时为第一个未读完的分区,
+		 * 否则从上次之后轮询, 优先已就绪的分区
+		 */
+		std::optional<std::size_t> pick() const {
+			auto n = m_parts.size();
+			std::optional<std::size_t> fallback;
+			for (std::size_t k = 0; k < n; ++k) {
+				auto i = (m_next + k) % n;
+				const auto& part = m_parts[i];
+				if (part.done || !part.cur) {
+					continue;
+				}
+				if (m_ordered || part.cur->ready()) {
+					return i;
+				}
+				if (!fallback) {
+					fallback = i;
+				}
+			}
+			return fallback;
+		}
+
+	private:
+		boost::asio::any_io_executor m_executor;
+		bool m_ordered;
+		std::vector<partition> m_parts;
+		std::size_t m_next{ 0 };
+	};
+
+}
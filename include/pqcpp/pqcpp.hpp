@@ -3,6 +3,22 @@
 #include <pqcpp/connection_option.hpp>
 #include <pqcpp/connection.hpp>
 #include <pqcpp/connection_pool.hpp>
+#include <pqcpp/io_context_pool.hpp>
+#include <pqcpp/retry.hpp>
+#include <pqcpp/cursor.hpp>
+#include <pqcpp/cluster_pool.hpp>
+#include <pqcpp/merge_cursor.hpp>
+#include <pqcpp/sharded_pool.hpp>
+#include <pqcpp/snapshot.hpp>
+#include <pqcpp/copy.hpp>
+#include <pqcpp/write_behind.hpp>
+#include <pqcpp/job_queue.hpp>
+#include <pqcpp/replication.hpp>
+#include <pqcpp/parallel_scan.hpp>
 #include <pqcpp/row.hpp>
 #include <pqcpp/query.hpp>
+#include <pqcpp/type_registry.hpp>
 #include <pqcpp/migration.hpp>
+#include <pqcpp/metrics.hpp>
+#include <pqcpp/tracer.hpp>
+#include <pqcpp/statement_stats.hpp>
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <chrono>
 #include <boost/lexical_cast.hpp>
 #include <pqcpp/converter.hpp>
 
@@ -53,6 +54,83 @@ struct query_op;
 			}
 		}
 
+		/**
+		 * @brief 以已转换的字段设置参数, 用于参数个数在运行时确定的语句(如多行 INSERT)
+		 * 
+		 * @param fields is_null 的字段以 NULL 发送
+		 */
+		void set_parameter_fields(std::vector<field> fields) {
+			m_params_values.clear();
+			m_params_lengths.clear();
+			m_params_formats.clear();
+			m_position_params = std::move(fields);
+			for (const auto& f : m_position_params) {
+				m_params_values.push_back(f.is_null ? nullptr : f.data());
+				m_params_lengths.push_back(f.size());
+				m_params_formats.push_back(f.format);
+			}
+		}
+
+		/**
+		 * @brief 以相同参数和名称构造另一条语句, 如包装为 DECLARE ... CURSOR FOR
+		 * 
+		 * @param cmd 新的 SQL
+		 * @return std::shared_ptr<query> 
+		 */
+		std::shared_ptr<query> with_command(std::string cmd) const {
+			auto q = std::make_shared<query>(std::move(cmd));
+			q->m_name = m_name;
+			q->m_read_only = m_read_only;
+			q->m_result_format = m_result_format;
+			q->m_position_params = m_position_params;
+			for (const auto& f : q->m_position_params) {
+				q->m_params_values.push_back(f.is_null ? nullptr : f.data());
+				q->m_params_lengths.push_back(f.size());
+				q->m_params_formats.push_back(f.format);
+			}
+			return q;
+		}
+
+		/**
+		 * @brief 设置语句名称, 用于追踪和统计
+		 * 
+		 * @param name 
+		 */
+		void set_name(std::string name) {
+			m_name = std::move(name);
+		}
+
+		const std::string& name() const {
+			return m_name;
+		}
+
+		/**
+		 * @brief 标记为只读, cluster_pool 据此路由到副本
+		 * 
+		 * @param read_only 
+		 */
+		void set_read_only(bool read_only) {
+			m_read_only = read_only;
+		}
+
+		bool read_only() const {
+			return m_read_only;
+		}
+
+		/**
+		 * @brief 结果格式, binary_format 时以扩展协议发送并按二进制返回全部列,
+		 * 可经 type_registry 解码复合/范围等类型
+		 * 
+		 * @param format 
+		 */
+		void set_result_format(field_format format) {
+			m_result_format = format;
+		}
+
+		field_format result_format() const {
+			return m_result_format;
+		}
+
 		bool not_result() const {
 			return m_not_result;
 		}
@@ -86,6 +164,19 @@ struct query_op;
 			return data_or_null(m_params_formats);
 		}
 
+		/**
+		 * @brief 发送数据量估算(SQL + 参数)
+		 *
+		 * @return std::size_t
+		 */
+		std::size_t payload_size() const {
+			std::size_t size = m_cmd.size();
+			for (auto len : m_params_lengths) {
+				size += static_cast<std::size_t>(len);
+			}
+			return size;
+		}
+
 	private:
 
 		template <typename Member>
@@ -100,11 +191,31 @@ struct query_op;
 
 	private:
 		std::string m_cmd;
+		std::string m_name;
 		std::vector<field> m_position_params;
 		std::vector<const char*> m_params_values;
 		std::vector<int> m_params_lengths;
 		std::vector<int> m_params_formats;
 		bool m_not_result{ false };
+		bool m_read_only{ false };
+		field_format m_result_format{ text_format };
+	};
+
+	/**
+	 * @brief 单次查询统计, 查询完成时交给连接的 query_observer
+	 */
+	struct query_stats {
+		const query& q;
+		// 发送到结果读取完毕的耗时
+		std::chrono::nanoseconds latency;
+		// false 表示网络/协议错误, SQL 执行错误仍为 true
+		bool success;
+		std::size_t bytes_sent;
+		// 结果集内存大小, 近似接收数据量
+		std::size_t bytes_received;
+		std::size_t rows;
+		// 存在执行失败的结果
+		bool sql_error{ false };
 	};
 
 }
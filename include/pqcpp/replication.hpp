@@ -0,0 +1,552 @@
+#pragma once
+
+#include <map>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <fmt/format.h>
+#include <pqcpp/connection.hpp>
+#include <pqcpp/connection_pool.hpp>
+#include <pqcpp/converter.hpp>
+#include <pqcpp/result.hpp>
+#include <pqcpp/logger.hpp>
+#include <pqcpp/detail/pgoutput.hpp>
+
+namespace pqcpp {
+
+	/**
+	 * @brief WAL 位置
+	 */
+	using lsn_t = std::uint64_t;
+
+	/**
+	 * @brief 格式化为 "16/B374D848"
+	 */
+	inline std::string format_lsn(lsn_t lsn) {
+		return fmt::format("{:X}/{:X}", lsn >> 32, lsn & 0xffffffff);
+	}
+
+	inline lsn_t parse_lsn(std::string_view s) {
+		auto slash = s.find('/');
+		if (slash == std::string_view::npos) {
+			throw std::invalid_argument("invalid lsn");
+		}
+		auto hi = std::stoull(std::string(s.substr(0, slash)), nullptr, 16);
+		auto lo = std::stoull(std::string(s.substr(slash + 1)), nullptr, 16);
+		return (hi << 32) | lo;
+	}
+
+	struct replication_option {
+		std::string slot;
+		std::vector<std::string> publications;
+		// 槽不存在时创建, 已存在则沿用
+		bool create_slot = false;
+		// 创建临时槽, 复制连接断开后自动删除
+		bool temporary_slot = false;
+		// 起始位置, 0 为槽的 confirmed_flush_lsn
+		lsn_t start_lsn = 0;
+		// 备机状态回报间隔, 须小于服务端 wal_sender_timeout
+		std::chrono::milliseconds status_interval{ 10000 };
+	};
+
+	struct relation_column {
+		std::string name;
+		std::uint32_t type_oid;
+		std::int32_t type_modifier;
+		// 属于复制标识(主键或 REPLICA IDENTITY 索引)
+		bool key;
+	};
+
+	/**
+	 * @brief 表结构, 来自 pgoutput Relation 消息, 表结构变化后会重新发送
+	 */
+	struct relation {
+		std::uint32_t oid;
+		std::string schema;
+		std::string name;
+		// REPLICA IDENTITY: 'd' 默认, 'n' 无, 'f' 全部列, 'i' 索引
+		char replica_identity;
+		std::vector<relation_column> columns;
+
+		int column_index(std::string_view column) const {
+			for (std::size_t i = 0; i < columns.size(); ++i) {
+				if (columns[i].name == column) {
+					return static_cast<int>(i);
+				}
+			}
+			throw std::out_of_range(fmt::format("relation {}.{} has no column {}", schema, name, column));
+		}
+	};
+
+	/**
+	 * @brief 一行数据, 列值为文本格式, 以 field_converter 转换
+	 */
+	class change_tuple {
+	public:
+		struct value {
+			// 'n' NULL, 'u' 未变化的 TOAST 值(未发送), 't' 文本
+			char kind;
+			std::string data;
+		};
+
+		change_tuple(std::shared_ptr<const relation> rel, std::vector<value> values)
+			:m_relation(std::move(rel)), m_values(std::move(values))
+		{}
+
+		std::size_t size() const {
+			return m_values.size();
+		}
+
+		bool is_null(int col) const {
+			return at(col).kind == 'n';
+		}
+
+		bool is_unchanged(int col) const {
+			return at(col).kind == 'u';
+		}
+
+		/**
+		 * @brief 按列号取值, NULL 与未变化的 TOAST 值均视为 NULL
+		 */
+		template <typename T = std::string>
+		T get(int col) const {
+			const auto& v = at(col);
+			field_view f{ v.data.data(), v.data.size(), v.kind == 'b' ? binary_format : text_format };
+			f.is_null = v.kind == 'n' || v.kind == 'u';
+			return field_converter<T>::from_field(f);
+		}
+
+		template <typename T = std::string>
+		T get(std::string_view column) const {
+			return get<T>(m_relation->column_index(column));
+		}
+
+		const std::shared_ptr<const relation>& rel() const {
+			return m_relation;
+		}
+
+	private:
+		const value& at(int col) const {
+			if (col < 0 || static_cast<std::size_t>(col) >= m_values.size()) {
+				throw std::out_of_range("column number out of column count");
+			}
+			return m_values[col];
+		}
+
+	private:
+		std::shared_ptr<const relation> m_relation;
+		std::vector<value> m_values;
+	};
+
+	enum class change_kind {
+		begin,
+		commit,
+		relation,
+		insert,
+		update,
+		remove,
+		truncate
+	};
+
+	struct change_event {
+		change_kind kind;
+		// 消息的 WAL 位置
+		lsn_t lsn{ 0 };
+		// 所属事务
+		std::uint32_t xid{ 0 };
+		// begin/commit: 提交位置和时间
+		lsn_t commit_lsn{ 0 };
+		std::chrono::system_clock::time_point commit_time;
+		// commit: 事务结束位置, 处理完成后以此 confirm()
+		lsn_t end_lsn{ 0 };
+		// relation/insert/update/remove
+		std::shared_ptr<const relation> rel;
+		// update(复制标识变化或 REPLICA IDENTITY FULL 时)/remove: 旧值, 可能只含键列
+		std::optional<change_tuple> old_tuple;
+		// insert/update: 新值
+		std::optional<change_tuple> new_tuple;
+		// truncate
+		std::vector<std::shared_ptr<const relation>> truncated;
+	};
+
+	/**
+	 * @brief pgoutput 消息解码, 维护 Relation 缓存和当前事务
+	 *
+	 * 不依赖连接, 可直接以录制的消息驱动
+	 */
+	class pgoutput_decoder {
+	public:
+		/**
+		 * @brief 解码一条 pgoutput 消息(XLogData 载荷), 不关心的消息(Origin/Type 等)返回空
+		 *
+		 * @param lsn 消息的 WAL 位置
+		 */
+		std::optional<change_event> decode(std::string_view message, lsn_t lsn) {
+			detail::wire_reader r(message);
+			return decode(r, lsn);
+		}
+
+		std::optional<change_event> decode(detail::wire_reader& r, lsn_t lsn) {
+			change_event ev;
+			ev.lsn = lsn;
+			ev.xid = m_xid;
+			switch (r.u8()) {
+			case 'B':
+				ev.kind = change_kind::begin;
+				ev.commit_lsn = r.u64();
+				ev.commit_time = detail::from_pg_timestamp(r.i64());
+				ev.xid = m_xid = r.u32();
+				m_in_transaction = true;
+				break;
+			case 'C':
+				ev.kind = change_kind::commit;
+				r.u8();
+				ev.commit_lsn = r.u64();
+				ev.end_lsn = r.u64();
+				ev.commit_time = detail::from_pg_timestamp(r.i64());
+				m_in_transaction = false;
+				m_delivered = ev.end_lsn;
+				break;
+			case 'R': {
+				auto rel = std::make_shared<relation>();
+				rel->oid = r.u32();
+				rel->schema = r.cstr();
+				rel->name = r.cstr();
+				rel->replica_identity = static_cast<char>(r.u8());
+				auto count = r.i16();
+				rel->columns.reserve(count);
+				for (int i = 0; i < count; ++i) {
+					relation_column col;
+					col.key = (r.u8() & 1) != 0;
+					col.name = r.cstr();
+					col.type_oid = r.u32();
+					col.type_modifier = r.i32();
+					rel->columns.push_back(std::move(col));
+				}
+				m_relations[rel->oid] = rel;
+				ev.kind = change_kind::relation;
+				ev.rel = std::move(rel);
+				break;
+			}
+			case 'I':
+				ev.kind = change_kind::insert;
+				ev.rel = find_relation(r.u32());
+				r.u8();
+				ev.new_tuple = read_tuple(r, ev.rel);
+				break;
+			case 'U': {
+				ev.kind = change_kind::update;
+				ev.rel = find_relation(r.u32());
+				auto tag = r.u8();
+				if (tag == 'K' || tag == 'O') {
+					ev.old_tuple = read_tuple(r, ev.rel);
+					r.u8();
+				}
+				ev.new_tuple = read_tuple(r, ev.rel);
+				break;
+			}
+			case 'D':
+				ev.kind = change_kind::remove;
+				ev.rel = find_relation(r.u32());
+				r.u8();
+				ev.old_tuple = read_tuple(r, ev.rel);
+				break;
+			case 'T': {
+				ev.kind = change_kind::truncate;
+				auto count = r.u32();
+				r.u8();
+				for (std::uint32_t i = 0; i < count; ++i) {
+					ev.truncated.push_back(find_relation(r.u32()));
+				}
+				break;
+			}
+			default:
+				return std::nullopt;
+			}
+			return ev;
+		}
+
+		bool in_transaction() const {
+			return m_in_transaction;
+		}
+
+		/**
+		 * @brief 最后一个已解码事务的结束位置
+		 */
+		lsn_t delivered_lsn() const {
+			return m_delivered;
+		}
+
+	private:
+		std::shared_ptr<const relation> find_relation(std::uint32_t oid) const {
+			auto it = m_relations.find(oid);
+			if (it == m_relations.end()) {
+				throw std::runtime_error(fmt::format("replication message for unknown relation {}", oid));
+			}
+			return it->second;
+		}
+
+		static change_tuple read_tuple(detail::wire_reader& r, std::shared_ptr<const relation> rel) {
+			auto count = r.i16();
+			std::vector<change_tuple::value> values;
+			values.reserve(count);
+			for (int i = 0; i < count; ++i) {
+				change_tuple::value v{ static_cast<char>(r.u8()), {} };
+				if (v.kind == 't' || v.kind == 'b') {
+					v.data = r.bytes(static_cast<std::size_t>(r.i32()));
+				}
+				values.push_back(std::move(v));
+			}
+			return change_tuple(std::move(rel), std::move(values));
+		}
+
+	private:
+		std::map<std::uint32_t, std::shared_ptr<const relation>> m_relations;
+		std::uint32_t m_xid{ 0 };
+		bool m_in_transaction{ false };
+		// 最后一个已交付事务的结束位置
+		lsn_t m_delivered{ 0 };
+	};
+
+	/**
+	 * @brief 逻辑复制(pgoutput)变更流
+	 *
+	 * 以复制模式连接, START_REPLICATION 后经 COPY BOTH 接收 WAL 消息, 解码为
+	 * begin/relation/insert/update/remove/commit 等事件. 备机状态回报在连接 strand 上
+	 * 按 status_interval 异步发送, 服务端请求时立即回复. 处理完一个事务后以 commit 事件的
+	 * end_lsn 调用 confirm(), 服务端据此推进槽位并回收 WAL; 未确认的事务在重连后重新发送
+	 *
+	 * @code
+	 * replication_option opt;
+	 * opt.slot = "cache_sync";
+	 * opt.publications = { "cache_pub" };
+	 * opt.create_slot = true;
+	 * auto stream = co_await replication_stream::open(pool, opt);
+	 * while (auto ev = co_await stream->next()) {
+	 *     if (ev->kind == change_kind::update) {
+	 *         invalidate(ev->new_tuple->get<int64_t>("id"));
+	 *     }
+	 *     else if (ev->kind == change_kind::commit) {
+	 *         stream->confirm(ev->end_lsn);
+	 *     }
+	 * }
+	 * @endcode
+	 */
+	class replication_stream {
+		struct progress {
+			std::atomic<lsn_t> received{ 0 };
+			std::atomic<lsn_t> flushed{ 0 };
+			std::atomic<bool> closed{ false };
+		};
+
+	public:
+		static awaitable<std::shared_ptr<replication_stream>> open(
+			std::string conn_str,
+			boost::asio::any_io_executor executor,
+			replication_option opt
+		) {
+			if (opt.slot.empty() || opt.publications.empty()) {
+				throw std::invalid_argument("replication requires a slot and at least one publication");
+			}
+			auto conn = connection::make(replication_conn_str(conn_str), std::move(executor));
+			co_await conn->async_connect(use_awaitable);
+			if (opt.create_slot) {
+				auto create = std::make_shared<query>(fmt::format(
+					"CREATE_REPLICATION_SLOT \"{}\" {}LOGICAL pgoutput NOEXPORT_SNAPSHOT",
+					opt.slot, opt.temporary_slot ? "TEMPORARY " : ""
+				));
+				auto results = co_await conn->async_query(create, use_awaitable);
+				for (const auto& res : results) {
+					if (!res->success() && res->sql_state() != sqlstate::duplicate_object) {
+						res->throw_if_error();
+					}
+				}
+			}
+			std::string publications;
+			for (const auto& p : opt.publications) {
+				publications += fmt::format(publications.empty() ? "\"{}\"" : ",\"{}\"", p);
+			}
+			auto start = std::make_shared<query>(fmt::format(
+				"START_REPLICATION SLOT \"{}\" LOGICAL {} (proto_version '1', publication_names '{}')",
+				opt.slot, format_lsn(opt.start_lsn), publications
+			));
+			auto results = co_await conn->async_copy_start(start, use_awaitable);
+			throw_if_copy_error(results);
+			if (results.empty() || results.back()->status() != PGRES_COPY_BOTH) {
+				throw std::runtime_error("START_REPLICATION did not enter COPY BOTH mode");
+			}
+			PQCPP_LOG_DEBUG("conn {} start replication slot {} at {}", conn->id(), opt.slot, format_lsn(opt.start_lsn));
+			std::shared_ptr<replication_stream> stream(new replication_stream(conn, opt));
+			co_spawn(conn->get_strand(), status_loop(conn, stream->m_progress, opt.status_interval), detached);
+			co_return stream;
+		}
+
+		/**
+		 * @brief 使用连接池的连接参数和 executor 建立独立的复制连接
+		 */
+		static awaitable<std::shared_ptr<replication_stream>> open(
+			std::shared_ptr<connection_pool> pool,
+			replication_option opt
+		) {
+			return open(pool->get_conn_str(), pool->get_executor(), std::move(opt));
+		}
+
+		replication_stream(const replication_stream&) = delete;
+		replication_stream& operator=(const replication_stream&) = delete;
+
+		~replication_stream() {
+			if (!m_progress->closed.exchange(true)) {
+				boost::asio::post(m_conn->get_strand(), [conn = m_conn]() {
+					conn->disconnect();
+				});
+			}
+		}
+
+		/**
+		 * @brief 取下一个事件, 服务端结束复制时为空; 同一时刻只能有一个 next() 等待
+		 */
+		awaitable<std::optional<change_event>> next() {
+			for (;;) {
+				auto data = co_await m_conn->async_copy_read(use_awaitable);
+				if (data.empty()) {
+					co_return std::nullopt;
+				}
+				detail::wire_reader r(data);
+				auto type = r.u8();
+				if (type == 'k') {
+					on_keepalive(r);
+					continue;
+				}
+				if (type != 'w') {
+					PQCPP_LOG_DEBUG("conn {} ignore replication message {}", m_conn->id(), static_cast<char>(type));
+					continue;
+				}
+				auto wal_start = r.u64();
+				r.u64();
+				r.i64();
+				advance(m_progress->received, wal_start);
+				auto event = m_decoder.decode(r, wal_start);
+				if (event) {
+					co_return event;
+				}
+			}
+		}
+
+		/**
+		 * @brief 确认 lsn 之前的变更已处理, 下次状态回报时告知服务端; 线程安全
+		 */
+		void confirm(lsn_t lsn) {
+			advance(m_progress->flushed, lsn);
+		}
+
+		lsn_t received_lsn() const {
+			return m_progress->received.load();
+		}
+
+		lsn_t confirmed_lsn() const {
+			return m_progress->flushed.load();
+		}
+
+		/**
+		 * @brief 回报最终确认位置并断开复制连接
+		 */
+		awaitable<void> close() {
+			if (m_progress->closed.exchange(true)) {
+				co_return;
+			}
+			if (m_conn->is_ready()) {
+				co_await co_spawn(m_conn->get_strand(), send_status(m_conn, m_progress), use_awaitable);
+			}
+			boost::asio::post(m_conn->get_strand(), [conn = m_conn]() {
+				conn->disconnect();
+			});
+		}
+
+	private:
+		replication_stream(std::shared_ptr<connection> conn, const replication_option& opt)
+			:m_conn(std::move(conn)), m_progress(std::make_shared<progress>())
+		{
+			m_progress->received = opt.start_lsn;
+			m_progress->flushed = opt.start_lsn;
+		}
+
+		static std::string replication_conn_str(const std::string& conn_str) {
+			if (conn_str.rfind("postgresql://", 0) == 0 || conn_str.rfind("postgres://", 0) == 0) {
+				return conn_str + (conn_str.find('?') == std::string::npos ? "?" : "&") + "replication=database";
+			}
+			return conn_str + " replication=database";
+		}
+
+		static void advance(std::atomic<lsn_t>& position, lsn_t lsn) {
+			auto current = position.load();
+			while (current < lsn && !position.compare_exchange_weak(current, lsn)) {}
+		}
+
+		/**
+		 * @brief 主机心跳: 空闲且已确认全部事务时把确认位置推进到服务端当前位置,
+		 * 避免槽位因无关库的 WAL 滞留
+		 */
+		void on_keepalive(detail::wire_reader& r) {
+			auto wal_end = r.u64();
+			r.i64();
+			bool reply = r.u8() != 0;
+			advance(m_progress->received, wal_end);
+			if (!m_decoder.in_transaction() && m_progress->flushed.load() >= m_decoder.delivered_lsn()) {
+				advance(m_progress->flushed, wal_end);
+			}
+			if (reply) {
+				co_spawn(m_conn->get_strand(), send_status(m_conn, m_progress), detached);
+			}
+		}
+
+		/**
+		 * @brief 按间隔回报状态, 在连接 strand 上运行
+		 */
+		static awaitable<void> status_loop(
+			std::shared_ptr<connection> conn,
+			std::shared_ptr<progress> p,
+			std::chrono::milliseconds interval
+		) {
+			while (!p->closed && conn->is_ready()) {
+				co_await detail::delay(conn->get_strand(), interval);
+				if (p->closed || !conn->is_ready()) {
+					break;
+				}
+				co_await send_status(conn, p);
+			}
+		}
+
+		/**
+		 * @brief 发送 Standby Status Update, 须在连接 strand 上调用
+		 */
+		static awaitable<void> send_status(std::shared_ptr<connection> conn, std::shared_ptr<progress> p) {
+			auto flushed = p->flushed.load();
+			std::string msg;
+			msg.reserve(34);
+			msg.push_back('r');
+			detail::write_uint(msg, p->received.load());
+			detail::write_uint(msg, flushed);
+			detail::write_uint(msg, flushed);
+			detail::write_uint(msg, static_cast<std::uint64_t>(detail::to_pg_timestamp(std::chrono::system_clock::now())));
+			msg.push_back(0);
+			try {
+				co_await conn->async_copy_write(boost::asio::buffer(msg), use_awaitable);
+			}
+			catch (const std::exception& ex) {
+				PQCPP_LOG_WARN("conn {} send standby status error: {}", conn->id(), ex.what());
+			}
+		}
+
+	private:
+		std::shared_ptr<connection> m_conn;
+		std::shared_ptr<progress> m_progress;
+		pgoutput_decoder m_decoder;
+	};
+
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string>
+#include <string_view>
+#include <stdexcept>
 #include <pqcpp/row.hpp>
 
 namespace pqcpp {
@@ -38,6 +41,51 @@ namespace pqcpp {
 			return PQresultErrorMessage(m_res);
 		}
 
+		/**
+		 * @brief 获取错误字段
+		 * 
+		 * @param field PG_DIAG_XXX
+		 * @return const char* 字段不存在时为空字符串
+		 */
+		const char* error_field(int field) const {
+			auto value = PQresultErrorField(m_res, field);
+			return value ? value : "";
+		}
+
+		/**
+		 * @brief SQLSTATE 错误码, 如 "40001"
+		 * 
+		 * @return const char* 
+		 */
+		const char* sql_state() const {
+			return error_field(PG_DIAG_SQLSTATE);
+		}
+
+		const char* error_detail() const {
+			return error_field(PG_DIAG_MESSAGE_DETAIL);
+		}
+
+		const char* error_hint() const {
+			return error_field(PG_DIAG_MESSAGE_HINT);
+		}
+
+		const char* constraint_name() const {
+			return error_field(PG_DIAG_CONSTRAINT_NAME);
+		}
+
+		const char* table_name() const {
+			return error_field(PG_DIAG_TABLE_NAME);
+		}
+
+		const char* column_name() const {
+			return error_field(PG_DIAG_COLUMN_NAME);
+		}
+
+		/**
+		 * @brief 失败时抛出 sql_error
+		 */
+		void throw_if_error() const;
+
 		bool success() const {
 			switch(this->status()){
 			case PGRES_COMMAND_OK:
@@ -66,6 +114,15 @@ namespace pqcpp {
 			return PQnfields(m_res);
 		}
 
+		/**
+		 * @brief 结果集占用内存
+		 * 
+		 * @return std::size_t 
+		 */
+		std::size_t memory_size() const {
+			return PQresultMemorySize(m_res);
+		}
+
 		bool is_null(int row, int col) const {
 			return PQgetisnull(m_res, row, col) == 1;
 		}
@@ -121,6 +178,110 @@ namespace pqcpp {
 		mutable std::shared_ptr<pqcpp::header> m_header;
 	};
 
+	/**
+	 * @brief 常用 SQLSTATE
+	 */
+	namespace sqlstate {
+		inline constexpr std::string_view serialization_failure = "40001";
+		inline constexpr std::string_view deadlock_detected = "40P01";
+		inline constexpr std::string_view unique_violation = "23505";
+		inline constexpr std::string_view foreign_key_violation = "23503";
+		inline constexpr std::string_view lock_not_available = "55P03";
+		inline constexpr std::string_view duplicate_object = "42710";
+		inline constexpr std::string_view query_canceled = "57014";
+	}
+
+	/**
+	 * @brief SQL 执行错误, 携带 SQLSTATE 和诊断字段
+	 */
+	class sql_error : public std::runtime_error {
+	public:
+		explicit sql_error(std::shared_ptr<const result> res)
+			:std::runtime_error(res->error_message()),
+			m_sql_state(res->sql_state()),
+			m_detail(res->error_detail()),
+			m_constraint(res->constraint_name()),
+			m_result(std::move(res))
+		{}
+
+		const std::string& sql_state() const {
+			return m_sql_state;
+		}
+
+		const std::string& detail() const {
+			return m_detail;
+		}
+
+		const std::string& constraint() const {
+			return m_constraint;
+		}
+
+		const std::shared_ptr<const pqcpp::result>& get_result() const {
+			return m_result;
+		}
+
+		/**
+		 * @brief SQLSTATE 类别(前两位), 如 "23" 完整性约束
+		 */
+		std::string_view sql_state_class() const {
+			return std::string_view(m_sql_state).substr(0, 2);
+		}
+
+		bool is_serialization_failure() const {
+			return m_sql_state == sqlstate::serialization_failure;
+		}
+
+		bool is_deadlock() const {
+			return m_sql_state == sqlstate::deadlock_detected;
+		}
+
+		/**
+		 * @brief 重新执行整个事务可能成功(40001/40P01)
+		 */
+		bool retryable() const {
+			return is_serialization_failure() || is_deadlock();
+		}
+
+	private:
+		std::string m_sql_state;
+		std::string m_detail;
+		std::string m_constraint;
+		std::shared_ptr<const pqcpp::result> m_result;
+	};
+
+	inline void result::throw_if_error() const {
+		if (!success()) {
+			throw sql_error(shared_from_this());
+		}
+	}
+
+	/**
+	 * @brief 任一结果失败时抛出 sql_error
+	 */
+	inline void throw_if_error(const std::vector<std::shared_ptr<result>>& results) {
+		for (const auto& res : results) {
+			res->throw_if_error();
+		}
+	}
+
+	/**
+	 * @brief 检查 async_copy_start 的结果, 除 COPY 状态外任一结果失败时抛出 sql_error
+	 *
+	 * 是否进入了预期的 COPY 状态由调用方检查
+	 */
+	inline void throw_if_copy_error(const std::vector<std::shared_ptr<result>>& results) {
+		for (const auto& res : results) {
+			switch (res->status()) {
+			case PGRES_COPY_IN:
+			case PGRES_COPY_OUT:
+			case PGRES_COPY_BOTH:
+				break;
+			default:
+				res->throw_if_error();
+			}
+		}
+	}
+
 };
 
 #include <pqcpp/detail/result_impl.hpp>
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <random>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <pqcpp/connection.hpp>
+#include <pqcpp/result.hpp>
+#include <pqcpp/logger.hpp>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 事务重试选项
+	 */
+	struct retry_option {
+		// 总尝试次数(含第一次)
+		int max_attempts = 5;
+		// 第 n 次重试前等待 [0, min(max_delay, base_delay * 2^(n-1))] 内的随机时间
+		std::chrono::milliseconds base_delay{ 5 };
+		std::chrono::milliseconds max_delay{ 500 };
+		// 自定义可重试判断, 为空时重试 40001/40P01
+		std::function<bool(const sql_error&)> retryable;
+	};
+
+	namespace detail {
+		inline std::chrono::microseconds retry_backoff(const retry_option& opt, int retry) {
+			thread_local std::mt19937_64 rng{ std::random_device{}() };
+			auto cap = std::chrono::duration_cast<std::chrono::microseconds>(opt.max_delay);
+			auto exp = std::chrono::duration_cast<std::chrono::microseconds>(opt.base_delay) * (std::int64_t{ 1 } << std::min(retry - 1, 20));
+			auto upper = std::min(cap, exp).count();
+			if (upper <= 0) {
+				return std::chrono::microseconds::zero();
+			}
+			return std::chrono::microseconds(std::uniform_int_distribution<std::int64_t>(0, upper)(rng));
+		}
+	}
+
+	/**
+	 * @brief 执行事务, 遇到序列化失败/死锁时带退避重试
+	 *
+	 * 每次尝试都会重新调用 f, f 须可重复执行; 事务体内的 SQL 失败需以 sql_error 抛出
+	 * (如 throw_if_error(results)), 提交时的失败由 transaction() 抛出.
+	 * 重试次数用尽或不可重试的错误原样抛出
+	 *
+	 * @param conn
+	 * @param level 事务隔离级别
+	 * @param f awaitable<T>()
+	 * @param opt
+	 */
+	template <typename F>
+	auto transaction_with_retry(
+		std::shared_ptr<connection> conn,
+		transaction::level level,
+		F f,
+		retry_option opt = {}
+	) -> std::invoke_result_t<F&> {
+		for (int attempt = 1;; ++attempt) {
+			try {
+				if constexpr (concept::is_void_coroutine_function_v<F&>) {
+					co_await conn->transaction(level, f);
+					co_return;
+				}
+				else {
+					co_return co_await conn->transaction(level, f);
+				}
+			}
+			catch (const sql_error& e) {
+				bool retryable = opt.retryable ? opt.retryable(e) : e.retryable();
+				if (!retryable || attempt >= opt.max_attempts) {
+					throw;
+				}
+				PQCPP_LOG_DEBUG(
+					"conn {} transaction attempt {} failed with {}, retry",
+					conn->id(), attempt, e.sql_state()
+				);
+			}
+			boost::asio::steady_timer timer(conn->get_executor(), detail::retry_backoff(opt, attempt));
+			co_await timer.async_wait(use_awaitable);
+		}
+	}
+
+	template <typename F>
+	auto transaction_with_retry(std::shared_ptr<connection> conn, F f, retry_option opt = {}) -> std::invoke_result_t<F&> {
+		return transaction_with_retry(std::move(conn), transaction::SERIALIZABLE, std::move(f), std::move(opt));
+	}
+
+}
@@ -143,6 +143,32 @@ namespace pqcpp {
 		 */
 		bool is_null(int col_num) const;
 
+		/**
+		 * @brief 列类型
+		 * 
+		 * @param col_num 
+		 * @return Oid 
+		 */
+		Oid col_type(int col_num) const;
+
+		/**
+		 * @brief 字段索引
+		 * 
+		 * @tparam String 
+		 * @param field_name 
+		 * @return int 
+		 */
+		template <typename String>
+		int field_index(const String& field_name) const;
+
+		/**
+		 * @brief 原始字段, 指向结果集内存, 不得超出结果集生命周期
+		 * 
+		 * @param col_num 
+		 * @return field_view 
+		 */
+		field_view raw(int col_num) const;
+
 		/**
 		 * @brief 根据列号转换并获取字段值
 		 * 
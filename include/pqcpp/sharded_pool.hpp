@@ -0,0 +1,216 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/format.h>
+#include <pqcpp/connection_pool.hpp>
+#include <pqcpp/merge_cursor.hpp>
+#include <pqcpp/detail/fan_out.hpp>
+
+namespace pqcpp {
+
+	struct shard_option {
+		// 分片名, 参与一致性哈希, 调整分片顺序不影响路由
+		std::string name;
+		std::string conn_str;
+	};
+
+	struct sharded_pool_option {
+		std::vector<shard_option> shards;
+		// 每个分片的连接池选项, name 作为指标标签前缀
+		connection_pool_option pool;
+		// 一致性哈希环上每个分片的虚拟节点数
+		std::size_t virtual_nodes = 160;
+		// 非空时整数键按范围路由: 分片 i 负责 [range_bounds[i-1], range_bounds[i]), 首尾无界,
+		// 须升序且大小为 shards.size() - 1; 字符串键始终按哈希路由
+		std::vector<std::int64_t> range_bounds;
+	};
+
+	namespace detail {
+		/**
+		 * @brief FNV-1a + splitmix64 终结混淆, 跨进程/平台稳定
+		 */
+		inline std::uint64_t shard_hash(std::string_view key) {
+			std::uint64_t h = 0xcbf29ce484222325ull;
+			for (unsigned char c : key) {
+				h ^= c;
+				h *= 0x100000001b3ull;
+			}
+			h ^= h >> 30;
+			h *= 0xbf58476d1ce4e5b9ull;
+			h ^= h >> 27;
+			h *= 0x94d049bb133111ebull;
+			h ^= h >> 31;
+			return h;
+		}
+	}
+
+	/**
+	 * @brief 客户端分片连接池
+	 *
+	 * 每个分片一个 connection_pool, 按分片键经一致性哈希环(或整数范围表)路由.
+	 * scatter() 在全部分片上并发执行同一查询, merge() 对各分片的有序结果做流式 k 路归并
+	 */
+	class sharded_pool : public std::enable_shared_from_this<sharded_pool> {
+	public:
+		using conn_ptr = connection_pool::conn_ptr;
+		using executor_type = boost::asio::any_io_executor;
+
+		static std::shared_ptr<sharded_pool> make(executor_type executor, const sharded_pool_option& option) {
+			return std::shared_ptr<sharded_pool>(new sharded_pool(std::move(executor), option));
+		}
+
+		static std::shared_ptr<sharded_pool> make(boost::asio::io_context& io, const sharded_pool_option& option) {
+			return make(io.get_executor(), option);
+		}
+
+		sharded_pool(const sharded_pool&) = delete;
+		sharded_pool& operator=(const sharded_pool&) = delete;
+
+		std::size_t size() const {
+			return m_shards.size();
+		}
+
+		const std::shared_ptr<connection_pool>& shard(std::size_t index) const {
+			return m_shards.at(index);
+		}
+
+		/**
+		 * @brief 字符串键所在分片
+		 */
+		std::size_t shard_for(std::string_view key) const {
+			auto h = detail::shard_hash(key);
+			auto it = std::lower_bound(m_ring.begin(), m_ring.end(), h, [](const auto& point, std::uint64_t value) {
+				return point.first < value;
+			});
+			if (it == m_ring.end()) {
+				it = m_ring.begin();
+			}
+			return it->second;
+		}
+
+		/**
+		 * @brief 整数键所在分片, 未配置 range_bounds 时按十进制字符串哈希(与 shard_for("42") 一致)
+		 */
+		std::size_t shard_for(std::int64_t key) const {
+			if (m_option.range_bounds.empty()) {
+				return shard_for(std::string_view(fmt::format_int(key).c_str()));
+			}
+			auto it = std::upper_bound(m_option.range_bounds.begin(), m_option.range_bounds.end(), key);
+			return static_cast<std::size_t>(it - m_option.range_bounds.begin());
+		}
+
+		template <typename Key>
+		const std::shared_ptr<connection_pool>& pool_for(const Key& key) const {
+			return m_shards[shard_for(key)];
+		}
+
+		/**
+		 * @brief 获取键所在分片的连接
+		 *
+		 * @param token void(boost::system::error_code, conn_ptr)
+		 */
+		template <typename Key, typename CompletionToken>
+		auto get(const Key& key, CompletionToken&& token) {
+			return pool_for(key)->get(std::forward<CompletionToken>(token));
+		}
+
+		/**
+		 * @brief 在键所在分片上执行查询
+		 */
+		template <typename Key>
+		awaitable<std::vector<std::shared_ptr<result>>> execute(const Key& key, std::shared_ptr<query> q) {
+			auto pool = pool_for(key);
+			auto conn = co_await pool->get(use_awaitable);
+			co_return co_await conn->async_query(q, use_awaitable);
+		}
+
+		/**
+		 * @brief 在全部分片上并发执行查询
+		 *
+		 * @return 按分片序号排列的各分片结果; 任一分片失败时抛出第一个异常
+		 */
+		awaitable<std::vector<std::vector<std::shared_ptr<result>>>> scatter(std::shared_ptr<query> q) {
+			std::vector<std::function<awaitable<std::vector<std::shared_ptr<result>>>()>> tasks;
+			for (const auto& pool : m_shards) {
+				tasks.push_back([pool, q]() {
+					return execute_on(pool, q);
+				});
+			}
+			co_return co_await detail::fan_out(m_executor, std::move(tasks));
+		}
+
+		/**
+		 * @brief 在全部分片上打开有序查询并归并为一个流
+		 *
+		 * @param q 须带 ORDER BY, 且顺序与 less 一致
+		 * @param less 行比较
+		 * @param opt 各分片游标选项
+		 */
+		awaitable<std::shared_ptr<merge_cursor>> merge(
+			std::shared_ptr<query> q,
+			merge_cursor::compare_type less,
+			cursor_option opt = {}
+		) {
+			std::vector<std::function<awaitable<conn_ptr>()>> tasks;
+			for (const auto& pool : m_shards) {
+				tasks.push_back([pool]() -> awaitable<conn_ptr> {
+					return pool->get(use_awaitable);
+				});
+			}
+			auto conns = co_await detail::fan_out(m_executor, std::move(tasks));
+			std::vector<merge_cursor::source> sources;
+			for (auto& conn : conns) {
+				sources.push_back({ std::move(conn), q });
+			}
+			co_return co_await merge_cursor::open(std::move(sources), std::move(less), std::move(opt));
+		}
+
+	private:
+		sharded_pool(executor_type executor, const sharded_pool_option& option)
+			:m_executor(std::move(executor)), m_option(option)
+		{
+			if (m_option.shards.empty()) {
+				throw std::invalid_argument("sharded_pool requires at least one shard");
+			}
+			if (!m_option.range_bounds.empty()) {
+				if (m_option.range_bounds.size() + 1 != m_option.shards.size()) {
+					throw std::invalid_argument("range_bounds size must be shards size - 1");
+				}
+				if (!std::is_sorted(m_option.range_bounds.begin(), m_option.range_bounds.end())) {
+					throw std::invalid_argument("range_bounds must be sorted");
+				}
+			}
+			for (std::size_t i = 0; i < m_option.shards.size(); ++i) {
+				const auto& s = m_option.shards[i];
+				auto opt = m_option.pool;
+				opt.name = fmt::format("{}-{}", m_option.pool.name, s.name);
+				m_shards.push_back(connection_pool::make(m_executor, s.conn_str, opt));
+				for (std::size_t v = 0; v < std::max<std::size_t>(m_option.virtual_nodes, 1); ++v) {
+					m_ring.emplace_back(detail::shard_hash(fmt::format("{}#{}", s.name, v)), i);
+				}
+			}
+			std::sort(m_ring.begin(), m_ring.end());
+		}
+
+		static awaitable<std::vector<std::shared_ptr<result>>> execute_on(
+			std::shared_ptr<connection_pool> pool,
+			std::shared_ptr<query> q
+		) {
+			auto conn = co_await pool->get(use_awaitable);
+			co_return co_await conn->async_query(q, use_awaitable);
+		}
+
+	private:
+		executor_type m_executor;
+		sharded_pool_option m_option;
+		std::vector<std::shared_ptr<connection_pool>> m_shards;
+		// (哈希值, 分片序号), 按哈希值排序
+		std::vector<std::pair<std::uint64_t, std::size_t>> m_ring;
+	};
+
+}
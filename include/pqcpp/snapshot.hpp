@@ -0,0 +1,140 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <exception>
+#include <pqcpp/connection_pool.hpp>
+#include <pqcpp/result.hpp>
+#include <pqcpp/transaction.hpp>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 导出的事务快照
+	 *
+	 * 协调连接开启 REPEATABLE READ(或 SERIALIZABLE) 只读事务并调用 pg_export_snapshot(),
+	 * 其他连接以 SET TRANSACTION SNAPSHOT 导入后与之看到同一时间点的数据.
+	 * 协调事务须保持到所有工作连接导入完成, 之后调用 release() 归还协调连接
+	 *
+	 * @code
+	 * auto snap = co_await exported_snapshot::open(pool);
+	 * auto worker = co_await snap->attach(); // 已在导入快照的只读事务中
+	 * co_await snap->release();
+	 * ...
+	 * co_await worker->async_rollback_transaction(use_awaitable);
+	 * @endcode
+	 */
+	class exported_snapshot {
+	public:
+		static awaitable<std::shared_ptr<exported_snapshot>> open(
+			std::shared_ptr<connection_pool> pool,
+			transaction::level level = transaction::REPEATABLE_READ
+		) {
+			if (level != transaction::REPEATABLE_READ && level != transaction::SERIALIZABLE) {
+				throw std::invalid_argument("snapshot export requires REPEATABLE READ or SERIALIZABLE");
+			}
+			static const auto export_query = std::make_shared<query>("SELECT pg_export_snapshot();");
+			std::shared_ptr<exported_snapshot> snap(new exported_snapshot(pool, level));
+			snap->m_conn = co_await pool->get(use_awaitable);
+			throw_if_error(co_await snap->m_conn->async_start_transaction(level, transaction::READ_ONLY, use_awaitable));
+			auto results = co_await snap->m_conn->async_query(export_query, use_awaitable);
+			throw_if_error(results);
+			snap->m_id = results.front()->get_value(0, 0);
+			PQCPP_LOG_DEBUG("conn {} exported snapshot {}", snap->m_conn->id(), snap->m_id);
+			co_return snap;
+		}
+
+		exported_snapshot(const exported_snapshot&) = delete;
+		exported_snapshot& operator=(const exported_snapshot&) = delete;
+
+		/**
+		 * @brief 未 release() 时在后台回滚协调事务, 完成后连接归还连接池
+		 */
+		~exported_snapshot() {
+			if (m_conn && m_conn->is_ready()) {
+				boost::asio::post(m_conn->get_strand(), [conn = m_conn]() {
+					auto on_rollback = [conn](error_code, std::vector<std::shared_ptr<result>>) {};
+					conn->async_rollback_transaction(on_rollback);
+				});
+			}
+		}
+
+		/**
+		 * @brief 快照 ID, 如 "00000003-0000001B-1"
+		 */
+		const std::string& id() const {
+			return m_id;
+		}
+
+		transaction::level level() const {
+			return m_level;
+		}
+
+		/**
+		 * @brief 在 conn 上开启只读事务并导入快照
+		 *
+		 * @param conn 不在事务中的连接
+		 */
+		awaitable<void> import(std::shared_ptr<connection> conn) const {
+			if (!m_conn) {
+				throw std::logic_error("snapshot already released");
+			}
+			auto set_snapshot = std::make_shared<query>(fmt::format("SET TRANSACTION SNAPSHOT '{}';", m_id));
+			throw_if_error(co_await conn->async_start_transaction(m_level, transaction::READ_ONLY, use_awaitable));
+			throw_if_error(co_await conn->async_query(set_snapshot, use_awaitable));
+		}
+
+		/**
+		 * @brief 从连接池借出连接并导入快照, 用完须结束事务
+		 */
+		awaitable<std::shared_ptr<connection>> attach() const {
+			auto conn = co_await m_pool->get(use_awaitable);
+			std::exception_ptr error;
+			try {
+				co_await import(conn);
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			if (error) {
+				// BEGIN 成功而导入失败时回滚, 避免连接带着事务归还连接池
+				try {
+					if (conn->is_ready() && conn->transaction_status() != PQTRANS_IDLE) {
+						co_await conn->async_rollback_transaction(use_awaitable);
+					}
+				}
+				catch (const std::exception& ex) {
+					PQCPP_LOG_WARN("conn {} rollback after snapshot import failure: {}", conn->id(), ex.what());
+				}
+				std::rethrow_exception(error);
+			}
+			co_return conn;
+		}
+
+		/**
+		 * @brief 结束协调事务并归还连接, 已导入快照的工作连接不受影响
+		 */
+		awaitable<void> release() {
+			if (!m_conn) {
+				co_return;
+			}
+			auto conn = std::move(m_conn);
+			if (conn->is_ready() && conn->transaction_status() != PQTRANS_IDLE) {
+				co_await conn->async_rollback_transaction(use_awaitable);
+			}
+		}
+
+	private:
+		exported_snapshot(std::shared_ptr<connection_pool> pool, transaction::level level)
+			:m_pool(std::move(pool)), m_level(level)
+		{}
+
+	private:
+		std::shared_ptr<connection_pool> m_pool;
+		transaction::level m_level;
+		std::shared_ptr<connection> m_conn;
+		std::string m_id;
+	};
+
+}
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <cctype>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <fmt/format.h>
+#include <pqcpp/query.hpp>
+#include <pqcpp/logger.hpp>
+#include <pqcpp/detail/hdr_histogram.hpp>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 规范化 SQL: 去注释, 字面量替换为 ?, IN 列表合并, 空白折叠
+	 *
+	 * @param sql
+	 * @return std::string
+	 */
+	inline std::string normalize_query(std::string_view sql) {
+		auto is_ident = [](char c) {
+			return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || static_cast<unsigned char>(c) >= 0x80;
+		};
+		std::string out;
+		out.reserve(sql.size());
+		auto emit_space = [&out]() {
+			if (!out.empty() && out.back() != ' ') {
+				out += ' ';
+			}
+		};
+		auto emit_placeholder = [&out]() {
+			// "?, ?" 合并为 "?", 使不同长度的 IN 列表归为同一条语句
+			auto n = out.size();
+			if (n >= 3 && out.compare(n - 3, 3, "?, ") == 0) {
+				out.resize(n - 2);
+				return;
+			}
+			if (n >= 2 && out.compare(n - 2, 2, "?,") == 0) {
+				out.resize(n - 1);
+				return;
+			}
+			out += '?';
+		};
+		std::size_t i = 0;
+		const std::size_t n = sql.size();
+		while (i < n) {
+			char c = sql[i];
+			if (std::isspace(static_cast<unsigned char>(c))) {
+				emit_space();
+				++i;
+			}
+			else if (c == '-' && i + 1 < n && sql[i + 1] == '-') {
+				while (i < n && sql[i] != '\n') {
+					++i;
+				}
+			}
+			else if (c == '/' && i + 1 < n && sql[i + 1] == '*') {
+				auto end = sql.find("*/", i + 2);
+				i = end == std::string_view::npos ? n : end + 2;
+				emit_space();
+			}
+			else if (c == '\'') {
+				++i;
+				while (i < n) {
+					if (sql[i] == '\'') {
+						if (i + 1 < n && sql[i + 1] == '\'') {
+							i += 2;
+							continue;
+						}
+						break;
+					}
+					++i;
+				}
+				++i;
+				emit_placeholder();
+			}
+			else if (c == '"') {
+				auto end = sql.find('"', i + 1);
+				end = end == std::string_view::npos ? n : end + 1;
+				out.append(sql.substr(i, end - i));
+				i = end;
+			}
+			else if (c == '$' && i + 1 < n && !std::isdigit(static_cast<unsigned char>(sql[i + 1]))) {
+				// $tag$ ... $tag$
+				auto tag_end = sql.find('$', i + 1);
+				if (tag_end == std::string_view::npos) {
+					out += c;
+					++i;
+					continue;
+				}
+				auto tag = sql.substr(i, tag_end - i + 1);
+				auto end = sql.find(tag, tag_end + 1);
+				i = end == std::string_view::npos ? n : end + tag.size();
+				emit_placeholder();
+			}
+			else if (c == '$') {
+				// 绑定参数 $n 原样保留
+				out += c;
+				++i;
+				while (i < n && std::isdigit(static_cast<unsigned char>(sql[i]))) {
+					out += sql[i++];
+				}
+			}
+			else if (std::isdigit(static_cast<unsigned char>(c)) && (out.empty() || !is_ident(out.back()))) {
+				while (i < n && (std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i] == '.'
+					|| ((sql[i] == '+' || sql[i] == '-') && (sql[i - 1] == 'e' || sql[i - 1] == 'E')))) {
+					++i;
+				}
+				emit_placeholder();
+			}
+			else {
+				out += c;
+				++i;
+			}
+		}
+		while (!out.empty() && (out.back() == ' ' || out.back() == ';')) {
+			out.pop_back();
+		}
+		return out;
+	}
+
+	struct statement_stats_option {
+		// 语句种类上限, 超出后归入 "<other>"
+		std::size_t max_statements = 5000;
+		// 慢查询阈值, 0 表示不记录慢查询
+		std::chrono::milliseconds slow_threshold{ 0 };
+		// 慢查询日志采样率 0 ~ 1
+		double slow_sample_rate = 1.0;
+	};
+
+	/**
+	 * @brief 单条规范化语句的统计快照, 时间单位微秒
+	 */
+	struct statement_summary {
+		std::string query;
+		std::uint64_t calls{ 0 };
+		std::uint64_t errors{ 0 };
+		std::uint64_t rows{ 0 };
+		std::uint64_t bytes_sent{ 0 };
+		std::uint64_t bytes_received{ 0 };
+		std::uint64_t total_us{ 0 };
+		std::uint64_t min_us{ 0 };
+		std::uint64_t max_us{ 0 };
+		std::uint64_t p50_us{ 0 };
+		std::uint64_t p95_us{ 0 };
+		std::uint64_t p99_us{ 0 };
+
+		double mean_us() const {
+			return calls ? static_cast<double>(total_us) / calls : 0;
+		}
+	};
+
+	/**
+	 * @brief 客户端按语句聚合的统计(类似 pg_stat_statements)
+	 *
+	 * 包含网络往返时间, 分片加锁, 可被多个连接并发记录
+	 */
+	class statement_stats {
+		static constexpr std::size_t shard_count = 16;
+
+		struct entry {
+			// 条目可能经由原始 SQL 缓存在另一分片锁下访问, 数据由自身锁保护
+			std::mutex mutex;
+			std::string query;
+			std::uint64_t calls{ 0 };
+			std::uint64_t errors{ 0 };
+			std::uint64_t rows{ 0 };
+			std::uint64_t bytes_sent{ 0 };
+			std::uint64_t bytes_received{ 0 };
+			std::uint64_t total_us{ 0 };
+			detail::hdr_histogram<> latency;
+		};
+
+		struct shard {
+			std::mutex mutex;
+			std::unordered_map<std::string, std::unique_ptr<entry>> entries;
+			// 原始 SQL 到规范化条目的缓存, 参数化查询无需重复规范化;
+			// 键指向 raw_keys 中的字符串(deque 追加不移动元素), 查找时不必构造 std::string
+			std::unordered_map<std::string_view, entry*> raw_index;
+			std::deque<std::string> raw_keys;
+		};
+
+	public:
+		explicit statement_stats(statement_stats_option option = {})
+			:m_option(option)
+		{}
+
+		/**
+		 * @brief 记录一次查询, 由 query_op 在完成时调用
+		 */
+		void record(const query_stats& stats) {
+			auto us = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(stats.latency).count());
+			std::string_view raw = stats.q.command();
+			auto& raw_shard = m_shards[std::hash<std::string_view>{}(raw) % shard_count];
+			entry* e = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(raw_shard.mutex);
+				auto it = raw_shard.raw_index.find(raw);
+				if (it != raw_shard.raw_index.end()) {
+					e = it->second;
+					update(*e, stats, us);
+				}
+			}
+			if (!e) {
+				auto normalized = normalize_query(raw);
+				if (m_count.load(std::memory_order_relaxed) >= m_option.max_statements) {
+					normalized = "<other>";
+				}
+				auto& s = m_shards[std::hash<std::string>{}(normalized) % shard_count];
+				std::size_t generation;
+				{
+					std::lock_guard<std::mutex> lock(s.mutex);
+					auto it = s.entries.find(normalized);
+					if (it == s.entries.end()) {
+						auto created = std::make_unique<entry>();
+						created->query = normalized;
+						it = s.entries.emplace(normalized, std::move(created)).first;
+						m_count.fetch_add(1, std::memory_order_relaxed);
+					}
+					e = it->second.get();
+					update(*e, stats, us);
+					generation = m_generation;
+				}
+				// 不同时持有两个分片锁; reset 之后不再缓存已失效的条目
+				std::lock_guard<std::mutex> lock(raw_shard.mutex);
+				if (generation == m_generation
+					&& raw_shard.raw_index.size() < m_option.max_statements
+					&& raw_shard.raw_index.find(raw) == raw_shard.raw_index.end()) {
+					raw_shard.raw_index.emplace(raw_shard.raw_keys.emplace_back(raw), e);
+				}
+			}
+			log_slow(stats, us);
+		}
+
+		/**
+		 * @brief 获取快照
+		 */
+		std::vector<statement_summary> snapshot() {
+			std::vector<statement_summary> out;
+			for (auto& s : m_shards) {
+				std::lock_guard<std::mutex> lock(s.mutex);
+				for (const auto& [key, e] : s.entries) {
+					std::lock_guard<std::mutex> entry_lock(e->mutex);
+					statement_summary summary;
+					summary.query = e->query;
+					summary.calls = e->calls;
+					summary.errors = e->errors;
+					summary.rows = e->rows;
+					summary.bytes_sent = e->bytes_sent;
+					summary.bytes_received = e->bytes_received;
+					summary.total_us = e->total_us;
+					summary.min_us = e->latency.min();
+					summary.max_us = e->latency.max();
+					summary.p50_us = e->latency.percentile(50);
+					summary.p95_us = e->latency.percentile(95);
+					summary.p99_us = e->latency.percentile(99);
+					out.push_back(std::move(summary));
+				}
+			}
+			std::sort(out.begin(), out.end(), [](const statement_summary& l, const statement_summary& r) {
+				return l.total_us > r.total_us;
+			});
+			return out;
+		}
+
+		/**
+		 * @brief 按总耗时排序输出文本表
+		 *
+		 * @param top 最多输出条数, 0 为全部
+		 */
+		std::string dump(std::size_t top = 20) {
+			auto all = snapshot();
+			if (top && all.size() > top) {
+				all.resize(top);
+			}
+			std::string out = fmt::format(
+				"{:>10} {:>8} {:>12} {:>10} {:>10} {:>10} {:>10} {:>10} {:>12} {:>12}  {}\n",
+				"calls", "errors", "total_ms", "mean_us", "p50_us", "p95_us", "p99_us", "rows", "bytes_sent", "bytes_recv", "query"
+			);
+			for (const auto& s : all) {
+				out += fmt::format(
+					"{:>10} {:>8} {:>12.1f} {:>10.0f} {:>10} {:>10} {:>10} {:>10} {:>12} {:>12}  {}\n",
+					s.calls, s.errors, s.total_us / 1000.0, s.mean_us(), s.p50_us, s.p95_us, s.p99_us,
+					s.rows, s.bytes_sent, s.bytes_received, s.query
+				);
+			}
+			return out;
+		}
+
+		void reset() {
+			std::vector<std::unique_lock<std::mutex>> locks;
+			for (auto& s : m_shards) {
+				locks.emplace_back(s.mutex);
+			}
+			for (auto& s : m_shards) {
+				s.raw_index.clear();
+				s.raw_keys.clear();
+				s.entries.clear();
+			}
+			m_count.store(0, std::memory_order_relaxed);
+			++m_generation;
+		}
+
+	private:
+		static void update(entry& e, const query_stats& stats, std::uint64_t us) {
+			std::lock_guard<std::mutex> lock(e.mutex);
+			++e.calls;
+			if (!stats.success || stats.sql_error) {
+				++e.errors;
+			}
+			e.rows += stats.rows;
+			e.bytes_sent += stats.bytes_sent;
+			e.bytes_received += stats.bytes_received;
+			e.total_us += us;
+			e.latency.record(us);
+		}
+
+		void log_slow(const query_stats& stats, std::uint64_t us) {
+			if (m_option.slow_threshold.count() == 0 || stats.latency < m_option.slow_threshold) {
+				return;
+			}
+			if (m_option.slow_sample_rate < 1.0) {
+				thread_local std::minstd_rand rng{ std::random_device{}() };
+				if (std::uniform_real_distribution<double>(0, 1)(rng) >= m_option.slow_sample_rate) {
+					return;
+				}
+			}
+			PQCPP_LOG_WARN("slow query {}us rows {}: {}", us, stats.rows, stats.q.command());
+		}
+
+	private:
+		statement_stats_option m_option;
+		std::array<shard, shard_count> m_shards;
+		std::atomic<std::size_t> m_count{ 0 };
+		// reset 次数, 读写均在分片锁内
+		std::size_t m_generation{ 0 };
+	};
+
+	namespace detail {
+		// 经 std::atomic_load/atomic_store 访问
+		inline std::shared_ptr<statement_stats> _global_statement_stats;
+	}
+
+	/**
+	 * @brief 开启全局语句统计, 传入空指针关闭
+	 *
+	 * 进行中的查询持有开始时的统计对象, 旧对象在这些查询结束后释放
+	 */
+	inline void set_statement_stats(std::shared_ptr<statement_stats> stats) {
+		std::atomic_store_explicit(&detail::_global_statement_stats, std::move(stats), std::memory_order_release);
+	}
+
+	/**
+	 * @brief 当前全局语句统计, 未开启时为空
+	 */
+	inline std::shared_ptr<statement_stats> global_statement_stats() {
+		return std::atomic_load_explicit(&detail::_global_statement_stats, std::memory_order_acquire);
+	}
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 单次查询各阶段时间点
+	 *
+	 * send -> flushed: 发送请求(客户端/网络)
+	 * flushed -> first_read: 等待服务端响应(网络 + 服务端执行)
+	 * first_read -> ready: 接收结果
+	 * ready -> drained: 客户端构造结果
+	 */
+	struct query_span {
+		using clock_type = std::chrono::steady_clock;
+		using time_point = clock_type::time_point;
+
+		std::size_t connection_id{ 0 };
+		// 语句名称, 未命名时为 SQL 文本
+		std::string_view statement;
+		// PQsendQuery 返回
+		time_point send;
+		// PQflush 返回 0
+		time_point flushed;
+		// 首次可读
+		time_point first_read;
+		// PQisBusy 返回 0
+		time_point ready;
+		// PQgetResult 取尽
+		time_point drained;
+		std::size_t rows{ 0 };
+		std::size_t result_bytes{ 0 };
+		bool success{ true };
+
+		clock_type::duration write_time() const {
+			return flushed - send;
+		}
+
+		clock_type::duration wait_time() const {
+			return first_read - flushed;
+		}
+
+		clock_type::duration receive_time() const {
+			return ready - first_read;
+		}
+
+		clock_type::duration decode_time() const {
+			return drained - ready;
+		}
+
+		clock_type::duration total_time() const {
+			return drained - send;
+		}
+	};
+
+	/**
+	 * @brief 查询追踪接口, 在连接 strand 上回调, 实现需自行保证线程安全
+	 */
+	class query_tracer {
+	public:
+		virtual ~query_tracer() {}
+
+		virtual void on_span(const query_span& span) = 0;
+	};
+
+	/**
+	 * @brief 将 span 以 JSON Lines 写入本地文件
+	 */
+	class file_tracer : public query_tracer {
+	public:
+		explicit file_tracer(const std::filesystem::path& path)
+			:m_out(path, std::ios::app)
+		{}
+
+		void on_span(const query_span& span) override {
+			using namespace std::chrono;
+			auto to_us = [](query_span::clock_type::duration d) {
+				return duration_cast<microseconds>(d).count();
+			};
+			// steady_clock 无绝对意义, 按当前时刻换算发送时的系统时间
+			auto wall = system_clock::now() - duration_cast<system_clock::duration>(query_span::clock_type::now() - span.send);
+			nlohmann::json j = {
+				{ "ts_us", duration_cast<microseconds>(wall.time_since_epoch()).count() },
+				{ "conn", span.connection_id },
+				{ "statement", span.statement },
+				{ "write_us", to_us(span.write_time()) },
+				{ "wait_us", to_us(span.wait_time()) },
+				{ "receive_us", to_us(span.receive_time()) },
+				{ "decode_us", to_us(span.decode_time()) },
+				{ "total_us", to_us(span.total_time()) },
+				{ "rows", span.rows },
+				{ "bytes", span.result_bytes },
+				{ "success", span.success }
+			};
+			auto line = j.dump();
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_out << line << '\n';
+		}
+
+		void flush() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_out.flush();
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::ofstream m_out;
+	};
+
+	namespace detail {
+		// 经 std::atomic_load/atomic_store 访问
+		inline std::shared_ptr<query_tracer> _global_tracer;
+	}
+
+	/**
+	 * @brief 设置全局查询追踪, 传入空指针关闭
+	 *
+	 * 进行中的查询持有开始时的 tracer, 旧 tracer 在这些查询结束后释放
+	 */
+	inline void set_tracer(std::shared_ptr<query_tracer> tracer) {
+		std::atomic_store_explicit(&detail::_global_tracer, std::move(tracer), std::memory_order_release);
+	}
+
+	/**
+	 * @brief 当前全局查询追踪, 未设置时为空
+	 */
+	inline std::shared_ptr<query_tracer> tracer() {
+		return std::atomic_load_explicit(&detail::_global_tracer, std::memory_order_acquire);
+	}
+
+}
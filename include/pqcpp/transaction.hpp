@@ -1,4 +1,5 @@
 #pragma once
+#include <string>
 #include <string_view>
 #include <stdexcept>
 
@@ -12,6 +13,11 @@ enum level {
 	READ_UNCOMMITTED
 };
 
+enum access {
+	READ_WRITE,
+	READ_ONLY
+};
+
 inline std::string_view to_string(level l){
 	switch (l)
 	{
@@ -28,5 +34,24 @@ inline std::string_view to_string(level l){
 	}
 }
 
+/**
+ * @brief BEGIN 语句, 每个级别只构造一次
+ */
+inline const std::string& begin_command(level l, access a = READ_WRITE) {
+	static const std::string commands[][2] = {
+		{ "BEGIN TRANSACTION ISOLATION LEVEL SERIALIZABLE;", "BEGIN TRANSACTION ISOLATION LEVEL SERIALIZABLE READ ONLY;" },
+		{ "BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ;", "BEGIN TRANSACTION ISOLATION LEVEL REPEATABLE READ READ ONLY;" },
+		{ "BEGIN TRANSACTION ISOLATION LEVEL READ COMMITTED;", "BEGIN TRANSACTION ISOLATION LEVEL READ COMMITTED READ ONLY;" },
+		{ "BEGIN TRANSACTION ISOLATION LEVEL READ UNCOMMITTED;", "BEGIN TRANSACTION ISOLATION LEVEL READ UNCOMMITTED READ ONLY;" }
+	};
+	if (l < SERIALIZABLE || l > READ_UNCOMMITTED) {
+		throw std::invalid_argument("unknow transaction level");
+	}
+	if (a != READ_WRITE && a != READ_ONLY) {
+		throw std::invalid_argument("unknow transaction access mode");
+	}
+	return commands[l][a];
+}
+
 }
 }
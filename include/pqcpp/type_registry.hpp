@@ -0,0 +1,583 @@
+#pragma once
+
+#include <limits>
+#include <tuple>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <fmt/format.h>
+#include <libpq-fe.h>
+#include <pqcpp/connection.hpp>
+#include <pqcpp/converter.hpp>
+#include <pqcpp/result.hpp>
+#include <pqcpp/row.hpp>
+#include <pqcpp/detail/pgoutput.hpp>
+
+namespace pqcpp {
+
+	/**
+	 * @brief 解码时用到的内置类型 OID
+	 */
+	namespace type_oid {
+		inline constexpr Oid json = 114;
+		inline constexpr Oid date = 1082;
+		inline constexpr Oid timestamp = 1114;
+		inline constexpr Oid timestamptz = 1184;
+		inline constexpr Oid record = 2249;
+		inline constexpr Oid jsonb = 3802;
+	}
+
+	namespace detail {
+		constexpr std::string_view load_types_cmd =
+R"(SELECT t.oid, n.nspname, t.typname, t.typtype, t.typcategory, t.typelem, t.typarray, t.typbasetype, coalesce(r.rngsubtype, 0)
+FROM pg_type t
+JOIN pg_namespace n ON n.oid = t.typnamespace
+LEFT JOIN pg_range r ON r.rngtypid = t.oid
+LEFT JOIN pg_class c ON c.oid = t.typrelid
+WHERE t.typrelid = 0 OR c.relkind = 'c' OR n.nspname NOT IN ('pg_catalog', 'information_schema', 'pg_toast');
+SELECT enumtypid, enumlabel FROM pg_enum ORDER BY enumtypid, enumsortorder;
+SELECT t.oid, a.attname, a.atttypid
+FROM pg_type t
+JOIN pg_namespace n ON n.oid = t.typnamespace
+JOIN pg_class c ON c.oid = t.typrelid
+JOIN pg_attribute a ON a.attrelid = t.typrelid
+WHERE a.attnum > 0 AND NOT a.attisdropped
+	AND (c.relkind = 'c' OR n.nspname NOT IN ('pg_catalog', 'information_schema', 'pg_toast'))
+ORDER BY t.oid, a.attnum;)";
+
+		template <typename T, typename = void>
+		struct has_from_field : std::false_type {};
+
+		template <typename T>
+		struct has_from_field<T, std::void_t<decltype(field_converter<T>::from_field(std::declval<const abstract_field&>()))>> : std::true_type {};
+	}
+
+	struct pg_type_info {
+		Oid oid{ 0 };
+		std::string schema;
+		std::string name;
+		// typtype: 'b' 基本, 'c' 复合, 'd' 域, 'e' 枚举, 'p' 伪类型, 'r' 范围, 'm' 多范围
+		char kind{ 'b' };
+		char category{ 'U' };
+		// 数组的元素类型
+		Oid element{ 0 };
+		// 对应的数组类型
+		Oid array{ 0 };
+		// 域的基础类型
+		Oid base{ 0 };
+		// 范围的元素类型
+		Oid subtype{ 0 };
+		// 枚举标签, 按排序顺序
+		std::vector<std::string> labels;
+		// 复合类型的属性名和类型
+		std::vector<std::pair<std::string, Oid>> attributes;
+	};
+
+	class type_registry;
+
+	/**
+	 * @brief 二进制格式解码, 可为自定义类型特化
+	 *
+	 * static T decode(const type_registry&, Oid type, const char* data, int size), data 为 nullptr 表示 NULL
+	 */
+	template <typename T, typename Enable = void>
+	struct binary_codec;
+
+	/**
+	 * @brief 类型注册表
+	 *
+	 * 从 pg_type/pg_attribute/pg_enum/pg_range 一次性加载类型信息, 据此解码二进制格式的
+	 * 复合(std::tuple 或 pg_composite)、范围(pg_range)、枚举(std::string)和域(按基础类型)值.
+	 * 查询须 set_result_format(binary_format); 文本格式的列回退到 field_converter
+	 *
+	 * @code
+	 * auto types = co_await pool->types();
+	 * auto q = std::make_shared<query>("SELECT address, during FROM orders");
+	 * q->set_result_format(binary_format);
+	 * ...
+	 * auto [street, zip] = types->get<std::tuple<std::string, int>>(r, "address");
+	 * auto during = types->get<pg_range<std::chrono::system_clock::time_point>>(r, 1);
+	 * @endcode
+	 */
+	class type_registry : public std::enable_shared_from_this<type_registry> {
+	public:
+		/**
+		 * @brief 创建空注册表, 由 add() 填充; pg_composite 持有注册表, 只能经 shared_ptr 创建
+		 */
+		static std::shared_ptr<type_registry> make() {
+			return std::shared_ptr<type_registry>(new type_registry());
+		}
+
+		static awaitable<std::shared_ptr<type_registry>> load(std::shared_ptr<connection> conn) {
+			static const auto q = std::make_shared<query>(std::string(detail::load_types_cmd));
+			auto results = co_await conn->async_query(q, use_awaitable);
+			throw_if_error(results);
+			if (results.size() != 3) {
+				throw std::runtime_error("unexpected type registry query results");
+			}
+			auto registry = make();
+			const auto& types = results[0];
+			for (int i = 0; i < types->row_count(); ++i) {
+				pg_type_info info;
+				info.oid = to_oid(types->get_value(i, 0));
+				info.schema = types->get_value(i, 1);
+				info.name = types->get_value(i, 2);
+				info.kind = types->get_value(i, 3)[0];
+				info.category = types->get_value(i, 4)[0];
+				info.element = to_oid(types->get_value(i, 5));
+				info.array = to_oid(types->get_value(i, 6));
+				info.base = to_oid(types->get_value(i, 7));
+				info.subtype = to_oid(types->get_value(i, 8));
+				registry->add(std::move(info));
+			}
+			const auto& labels = results[1];
+			for (int i = 0; i < labels->row_count(); ++i) {
+				if (auto it = registry->m_types.find(to_oid(labels->get_value(i, 0))); it != registry->m_types.end()) {
+					it->second.labels.emplace_back(labels->get_value(i, 1));
+				}
+			}
+			const auto& attributes = results[2];
+			for (int i = 0; i < attributes->row_count(); ++i) {
+				if (auto it = registry->m_types.find(to_oid(attributes->get_value(i, 0))); it != registry->m_types.end()) {
+					it->second.attributes.emplace_back(attributes->get_value(i, 1), to_oid(attributes->get_value(i, 2)));
+				}
+			}
+			PQCPP_LOG_DEBUG("conn {} loaded {} types", conn->id(), registry->size());
+			co_return registry;
+		}
+
+		/**
+		 * @brief 添加或替换类型信息
+		 */
+		void add(pg_type_info info) {
+			m_names[info.schema + "." + info.name] = info.oid;
+			auto oid = info.oid;
+			m_types[oid] = std::move(info);
+		}
+
+		const pg_type_info* find(Oid oid) const {
+			auto it = m_types.find(oid);
+			return it == m_types.end() ? nullptr : &it->second;
+		}
+
+		/**
+		 * @brief 按 "schema.name" 查找, 不带 schema 时依次查找 pg_catalog 和 public
+		 */
+		const pg_type_info* find(std::string_view name) const {
+			if (name.find('.') != std::string_view::npos) {
+				auto it = m_names.find(std::string(name));
+				return it == m_names.end() ? nullptr : find(it->second);
+			}
+			for (auto schema : { "pg_catalog.", "public." }) {
+				auto it = m_names.find(schema + std::string(name));
+				if (it != m_names.end()) {
+					return find(it->second);
+				}
+			}
+			return nullptr;
+		}
+
+		/**
+		 * @brief 域解析为最终的基础类型, 其他类型原样返回
+		 */
+		Oid resolve(Oid oid) const {
+			for (auto info = find(oid); info && info->kind == 'd' && info->base; info = find(oid)) {
+				oid = info->base;
+			}
+			return oid;
+		}
+
+		std::size_t size() const {
+			return m_types.size();
+		}
+
+		/**
+		 * @brief 二进制格式即文本的类型: 字符串类、枚举及 json/jsonb, 未加载的类型视为否
+		 */
+		bool is_textual(Oid oid) const {
+			oid = resolve(oid);
+			if (oid == type_oid::json || oid == type_oid::jsonb) {
+				return true;
+			}
+			auto info = find(oid);
+			return info && (info->category == 'S' || info->kind == 'e');
+		}
+
+		/**
+		 * @brief 解码字段, 文本格式时使用 field_converter
+		 */
+		template <typename T>
+		T decode(Oid type, const field_view& f) const {
+			if (f.format == text_format) {
+				if constexpr (detail::has_from_field<T>::value) {
+					return field_converter<T>::from_field(f);
+				}
+				else {
+					throw std::invalid_argument("type registry decoding requires binary result format");
+				}
+			}
+			return binary_codec<T>::decode(*this, type, f.null() ? nullptr : f.data(), f.size());
+		}
+
+		template <typename T = std::string>
+		T get(const row& r, int col_num) const {
+			return decode<T>(r.col_type(col_num), r.raw(col_num));
+		}
+
+		template <typename T = std::string, typename String>
+		T get(const row& r, const String& field_name) const {
+			return get<T>(r, r.field_index(field_name));
+		}
+
+	private:
+		type_registry() = default;
+
+		static Oid to_oid(const char* value) {
+			return static_cast<Oid>(std::stoul(value));
+		}
+
+	private:
+		std::unordered_map<Oid, pg_type_info> m_types;
+		std::unordered_map<std::string, Oid> m_names;
+	};
+
+	/**
+	 * @brief 范围值, 无界一侧为 nullopt
+	 */
+	template <typename T>
+	struct pg_range {
+		std::optional<T> lower;
+		std::optional<T> upper;
+		bool lower_inclusive{ false };
+		bool upper_inclusive{ false };
+		bool empty{ false };
+	};
+
+	/**
+	 * @brief 按属性名或序号访问的复合值, 匿名 record 只能按序号访问
+	 */
+	class pg_composite {
+	public:
+		struct value {
+			Oid type;
+			std::optional<std::string> data;
+		};
+
+		pg_composite(std::shared_ptr<const type_registry> registry, Oid type, std::vector<value> values)
+			:m_registry(std::move(registry)), m_type(type), m_values(std::move(values))
+		{}
+
+		Oid type() const {
+			return m_type;
+		}
+
+		std::size_t size() const {
+			return m_values.size();
+		}
+
+		bool is_null(int index) const {
+			return !at(index).data;
+		}
+
+		Oid field_type(int index) const {
+			return at(index).type;
+		}
+
+		int field_index(std::string_view name) const {
+			auto info = m_registry->find(m_registry->resolve(m_type));
+			if (info) {
+				for (std::size_t i = 0; i < info->attributes.size(); ++i) {
+					if (info->attributes[i].first == name) {
+						return static_cast<int>(i);
+					}
+				}
+			}
+			throw std::out_of_range(fmt::format("composite type {} has no attribute {}", m_type, name));
+		}
+
+		template <typename T = std::string>
+		T get(int index) const {
+			const auto& v = at(index);
+			return binary_codec<T>::decode(
+				*m_registry, v.type,
+				v.data ? v.data->data() : nullptr,
+				v.data ? static_cast<int>(v.data->size()) : 0
+			);
+		}
+
+		template <typename T = std::string>
+		T get(std::string_view name) const {
+			return get<T>(field_index(name));
+		}
+
+	private:
+		const value& at(int index) const {
+			if (index < 0 || static_cast<std::size_t>(index) >= m_values.size()) {
+				throw std::out_of_range("composite index out of range");
+			}
+			return m_values[index];
+		}
+
+	private:
+		std::shared_ptr<const type_registry> m_registry;
+		Oid m_type;
+		std::vector<value> m_values;
+	};
+
+	template <typename T>
+	struct binary_codec<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+		static T decode(const type_registry&, Oid type, const char* data, int size) {
+			if (!data) {
+				return T{};
+			}
+			detail::wire_reader r(std::string_view(data, static_cast<std::size_t>(size)));
+			switch (size) {
+			case 1:
+				return static_cast<T>(static_cast<std::int8_t>(r.u8()));
+			case 2:
+				return static_cast<T>(r.i16());
+			case 4:
+				if constexpr (std::is_unsigned_v<T>) {
+					return static_cast<T>(r.u32());
+				}
+				else {
+					return static_cast<T>(r.i32());
+				}
+			case 8:
+				return static_cast<T>(r.i64());
+			default:
+				throw std::invalid_argument(fmt::format("cannot decode type {} of {} bytes as integer", type, size));
+			}
+		}
+	};
+
+	template <typename T>
+	struct binary_codec<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+		static T decode(const type_registry&, Oid type, const char* data, int size) {
+			if (!data) {
+				return T{};
+			}
+			detail::wire_reader r(std::string_view(data, static_cast<std::size_t>(size)));
+			if (size == 4) {
+				auto bits = r.u32();
+				float value;
+				std::memcpy(&value, &bits, sizeof(value));
+				return static_cast<T>(value);
+			}
+			if (size == 8) {
+				auto bits = r.u64();
+				double value;
+				std::memcpy(&value, &bits, sizeof(value));
+				return static_cast<T>(value);
+			}
+			throw std::invalid_argument(fmt::format("cannot decode type {} of {} bytes as floating point", type, size));
+		}
+	};
+
+	template <>
+	struct binary_codec<bool> {
+		static bool decode(const type_registry&, Oid, const char* data, int size) {
+			return data && size > 0 && data[0] != 0;
+		}
+	};
+
+	/**
+	 * @brief 文本类、枚举(标签)及 json/jsonb, 其他类型的二进制格式不是文本, 抛出 invalid_argument
+	 */
+	template <>
+	struct binary_codec<std::string> {
+		static std::string decode(const type_registry& registry, Oid type, const char* data, int size) {
+			if (!data) {
+				return {};
+			}
+			if (!registry.is_textual(type)) {
+				throw std::invalid_argument(fmt::format("cannot decode binary value of type {} as string", type));
+			}
+			// jsonb 二进制格式以版本号字节开头
+			if (size > 0 && registry.resolve(type) == type_oid::jsonb) {
+				return std::string(data + 1, static_cast<std::size_t>(size - 1));
+			}
+			return std::string(data, static_cast<std::size_t>(size));
+		}
+	};
+
+	template <>
+	struct binary_codec<json> {
+		static json decode(const type_registry& registry, Oid type, const char* data, int size) {
+			if (!data) {
+				return nullptr;
+			}
+			return json::parse(binary_codec<std::string>::decode(registry, type, data, size));
+		}
+	};
+
+	template <typename T, typename Alloc>
+	struct binary_codec<std::vector<T, Alloc>, std::enable_if_t<sizeof(T) == 1>> {
+		static std::vector<T, Alloc> decode(const type_registry&, Oid, const char* data, int size) {
+			if (!data) {
+				return {};
+			}
+			return std::vector<T, Alloc>((const T*)data, (const T*)(data + size));
+		}
+	};
+
+	template <typename T>
+	struct binary_codec<std::optional<T>> {
+		static std::optional<T> decode(const type_registry& registry, Oid type, const char* data, int size) {
+			if (!data) {
+				return std::nullopt;
+			}
+			return binary_codec<T>::decode(registry, type, data, size);
+		}
+	};
+
+	/**
+	 * @brief timestamp/timestamptz(UTC) 和 date, ±infinity 映射为 max()/min()
+	 */
+	template <>
+	struct binary_codec<std::chrono::system_clock::time_point> {
+		using time_point = std::chrono::system_clock::time_point;
+
+		static time_point decode(const type_registry& registry, Oid type, const char* data, int size) {
+			if (!data) {
+				return {};
+			}
+			detail::wire_reader r(std::string_view(data, static_cast<std::size_t>(size)));
+			if (size == 8) {
+				return from_microseconds(r.i64());
+			}
+			if (size == 4 && registry.resolve(type) == type_oid::date) {
+				auto days = r.i32();
+				if (days == std::numeric_limits<std::int32_t>::max()) {
+					return time_point::max();
+				}
+				if (days == std::numeric_limits<std::int32_t>::min()) {
+					return time_point::min();
+				}
+				return from_microseconds(static_cast<std::int64_t>(days) * 86400 * 1000000);
+			}
+			throw std::invalid_argument(fmt::format("cannot decode type {} of {} bytes as time point", type, size));
+		}
+
+	private:
+		static time_point from_microseconds(std::int64_t us) {
+			if (us == std::numeric_limits<std::int64_t>::max()) {
+				return time_point::max();
+			}
+			if (us == std::numeric_limits<std::int64_t>::min()) {
+				return time_point::min();
+			}
+			return detail::from_pg_timestamp(us);
+		}
+	};
+
+	/**
+	 * @brief 复合类型/record 按属性顺序解码为 tuple, 属性数须一致
+	 */
+	template <typename ...Args>
+	struct binary_codec<std::tuple<Args...>> {
+		static std::tuple<Args...> decode(const type_registry& registry, Oid type, const char* data, int size) {
+			if (!data) {
+				return {};
+			}
+			detail::wire_reader r(std::string_view(data, static_cast<std::size_t>(size)));
+			auto count = r.i32();
+			if (count != static_cast<std::int32_t>(sizeof...(Args))) {
+				throw std::invalid_argument(fmt::format("composite type {} has {} attributes, expected {}", type, count, sizeof...(Args)));
+			}
+			// 花括号初始化保证从左到右求值
+			return std::tuple<Args...>{ read_attribute<Args>(registry, r)... };
+		}
+
+	private:
+		template <typename U>
+		static U read_attribute(const type_registry& registry, detail::wire_reader& r) {
+			auto type = static_cast<Oid>(r.u32());
+			auto length = r.i32();
+			if (length < 0) {
+				return binary_codec<U>::decode(registry, type, nullptr, 0);
+			}
+			auto bytes = r.view(static_cast<std::size_t>(length));
+			return binary_codec<U>::decode(registry, type, bytes.data(), length);
+		}
+	};
+
+	template <>
+	struct binary_codec<pg_composite> {
+		static pg_composite decode(const type_registry& registry, Oid type, const char* data, int size) {
+			std::vector<pg_composite::value> values;
+			if (data) {
+				detail::wire_reader r(std::string_view(data, static_cast<std::size_t>(size)));
+				auto count = r.i32();
+				values.reserve(static_cast<std::size_t>(std::max(count, 0)));
+				for (std::int32_t i = 0; i < count; ++i) {
+					pg_composite::value v{ static_cast<Oid>(r.u32()), std::nullopt };
+					auto length = r.i32();
+					if (length >= 0) {
+						v.data = r.bytes(static_cast<std::size_t>(length));
+					}
+					values.push_back(std::move(v));
+				}
+			}
+			return pg_composite(registry.shared_from_this(), type, std::move(values));
+		}
+	};
+
+	/**
+	 * @brief 范围类型, 边界按注册表中的元素类型解码
+	 */
+	template <typename T>
+	struct binary_codec<pg_range<T>> {
+		enum : std::uint8_t {
+			empty = 0x01,
+			lower_inclusive = 0x02,
+			upper_inclusive = 0x04,
+			lower_infinite = 0x08,
+			upper_infinite = 0x10,
+			lower_null = 0x20,
+			upper_null = 0x40
+		};
+
+		static pg_range<T> decode(const type_registry& registry, Oid type, const char* data, int size) {
+			pg_range<T> range;
+			if (!data) {
+				return range;
+			}
+			auto info = registry.find(registry.resolve(type));
+			if (!info || info->kind != 'r') {
+				throw std::invalid_argument(fmt::format("type {} is not a range type", type));
+			}
+			detail::wire_reader r(std::string_view(data, static_cast<std::size_t>(size)));
+			auto flags = r.u8();
+			range.empty = (flags & empty) != 0;
+			range.lower_inclusive = (flags & lower_inclusive) != 0;
+			range.upper_inclusive = (flags & upper_inclusive) != 0;
+			if (range.empty) {
+				return range;
+			}
+			if (!(flags & (lower_infinite | lower_null))) {
+				range.lower = read_bound(registry, info->subtype, r);
+			}
+			if (!(flags & (upper_infinite | upper_null))) {
+				range.upper = read_bound(registry, info->subtype, r);
+			}
+			return range;
+		}
+
+	private:
+		static T read_bound(const type_registry& registry, Oid subtype, detail::wire_reader& r) {
+			auto length = r.i32();
+			auto bytes = r.view(static_cast<std::size_t>(length));
+			return binary_codec<T>::decode(registry, subtype, bytes.data(), length);
+		}
+	};
+
+}
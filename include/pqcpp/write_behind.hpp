@@ -0,0 +1,355 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <pqcpp/connection_pool.hpp>
+#include <pqcpp/copy.hpp>
+#include <pqcpp/result.hpp>
+#include <pqcpp/logger.hpp>
+#include <pqcpp/detail/waiter_list.hpp>
+
+namespace pqcpp {
+
+	struct write_behind_option {
+		// 缓冲达到该行数立即刷出, 也是单批上限
+		std::size_t batch_rows = 1000;
+		// 最长缓冲时间
+		std::chrono::milliseconds flush_interval{ 100 };
+		// 缓冲行数上限, 达到后 append() 等待, try_append() 返回 false
+		std::size_t max_buffered_rows = 100000;
+		// 单批行数不小于该值时用 COPY, 否则用多行 INSERT; 0 为总是 COPY
+		std::size_t copy_threshold = 200;
+		// 并发刷出的连接数, 大于 1 时批之间不保证顺序
+		std::size_t concurrency = 1;
+	};
+
+	struct write_behind_stats {
+		std::size_t appended{ 0 };
+		std::size_t written{ 0 };
+		// 写入失败而丢弃的行数
+		std::size_t failed{ 0 };
+		std::size_t batches{ 0 };
+		std::size_t buffered{ 0 };
+	};
+
+	/**
+	 * @brief 写后缓冲插入
+	 *
+	 * 调用者追加行后立即返回, 后台按行数或时间阈值把缓冲的行合并为一条多行 INSERT
+	 * 或一次 COPY 写入, N 次往返变为每批一次. 缓冲有界, 满时 append() 等待;
+	 * close()(或析构)时刷出全部剩余行. 写入失败的批记录日志并计入 failed, 不重试
+	 *
+	 * @code
+	 * auto sink = write_behind_sink::make(pool, "audit_log", { "ts", "user_id", "action" });
+	 * sink->try_append(now, user_id, "login");
+	 * co_await sink->append(now, user_id, "logout");
+	 * co_await sink->close();
+	 * @endcode
+	 */
+	class write_behind_sink {
+		struct state {
+			std::mutex mutex;
+			std::deque<std::vector<field>> rows;
+			bool closing{ false };
+			// 已请求立即刷出的行序号
+			std::size_t flush_target{ 0 };
+			std::size_t flushers{ 0 };
+			write_behind_stats stats;
+			detail::waiter_list flusher_waiters;
+			detail::waiter_list producer_waiters;
+			detail::waiter_list drain_waiters;
+		};
+
+	public:
+		/**
+		 * @param table 表名, 原样拼入 SQL
+		 * @param columns 列名, 原样拼入 SQL
+		 */
+		static std::shared_ptr<write_behind_sink> make(
+			std::shared_ptr<connection_pool> pool,
+			std::string table,
+			std::vector<std::string> columns,
+			write_behind_option opt = {}
+		) {
+			if (columns.empty()) {
+				throw std::invalid_argument("write_behind_sink requires at least one column");
+			}
+			std::shared_ptr<write_behind_sink> sink(new write_behind_sink(std::move(pool), std::move(table), std::move(columns), opt));
+			sink->start();
+			return sink;
+		}
+
+		write_behind_sink(const write_behind_sink&) = delete;
+		write_behind_sink& operator=(const write_behind_sink&) = delete;
+
+		/**
+		 * @brief 后台刷出剩余行后退出, 须保持 executor 运行至刷出完成
+		 */
+		~write_behind_sink() {
+			detail::waiter_list::notify(update([](state& s) {
+				s.closing = true;
+			}, &state::flusher_waiters));
+		}
+
+		/**
+		 * @brief 不等待地追加一行, 缓冲已满或已关闭时返回 false
+		 */
+		template <typename ...Args>
+		bool try_append(const Args& ...args) {
+			auto row = make_row(args...);
+			std::vector<std::function<void()>> waiters;
+			{
+				std::unique_lock lock(m_state->mutex);
+				if (m_state->closing || m_state->rows.size() >= m_option.max_buffered_rows) {
+					return false;
+				}
+				push(*m_state, std::move(row), waiters);
+			}
+			detail::waiter_list::notify(std::move(waiters));
+			return true;
+		}
+
+		/**
+		 * @brief 追加一行, 缓冲已满时等待
+		 */
+		template <typename ...Args>
+		awaitable<void> append(const Args& ...args) {
+			auto row = make_row(args...);
+			auto max_rows = m_option.max_buffered_rows;
+			for (;;) {
+				co_await detail::wait_until(m_state, &state::producer_waiters, [max_rows](const state& s) {
+					return s.closing || s.rows.size() < max_rows;
+				});
+				std::vector<std::function<void()>> waiters;
+				{
+					std::unique_lock lock(m_state->mutex);
+					if (m_state->closing) {
+						throw std::logic_error("write_behind_sink is closed");
+					}
+					// 多个等待者同时被唤醒时可能再次满
+					if (m_state->rows.size() >= max_rows) {
+						continue;
+					}
+					push(*m_state, std::move(row), waiters);
+				}
+				detail::waiter_list::notify(std::move(waiters));
+				co_return;
+			}
+		}
+
+		/**
+		 * @brief 立即刷出此前追加的行并等待写入完成(含失败)
+		 */
+		awaitable<void> flush() {
+			std::size_t target = 0;
+			detail::waiter_list::notify(update([&target](state& s) {
+				target = s.stats.appended;
+				s.flush_target = std::max(s.flush_target, target);
+			}, &state::flusher_waiters));
+			co_await detail::wait_until(m_state, &state::drain_waiters, [target](const state& s) {
+				return s.stats.written + s.stats.failed >= target;
+			});
+		}
+
+		/**
+		 * @brief 停止接收并刷出全部剩余行
+		 */
+		awaitable<void> close() {
+			detail::waiter_list::notify(update([](state& s) {
+				s.closing = true;
+			}, &state::flusher_waiters));
+			detail::waiter_list::notify(update([](state&) {}, &state::producer_waiters));
+			co_await detail::wait_until(m_state, &state::drain_waiters, [](const state& s) {
+				return s.flushers == 0;
+			});
+		}
+
+		write_behind_stats stats() const {
+			std::unique_lock lock(m_state->mutex);
+			auto s = m_state->stats;
+			s.buffered = m_state->rows.size();
+			return s;
+		}
+
+	private:
+		write_behind_sink(
+			std::shared_ptr<connection_pool> pool,
+			std::string table,
+			std::vector<std::string> columns,
+			const write_behind_option& opt
+		)
+			:m_pool(std::move(pool)), m_table(std::move(table)), m_columns(std::move(columns)),
+			m_option(opt), m_state(std::make_shared<state>())
+		{
+			m_option.batch_rows = std::max<std::size_t>(m_option.batch_rows, 1);
+			m_option.max_buffered_rows = std::max(m_option.max_buffered_rows, m_option.batch_rows);
+			m_option.concurrency = std::max<std::size_t>(m_option.concurrency, 1);
+		}
+
+		void start() {
+			m_state->flushers = m_option.concurrency;
+			for (std::size_t i = 0; i < m_option.concurrency; ++i) {
+				co_spawn(m_pool->get_executor(), flusher(m_pool, m_state, m_table, m_columns, m_option), detached);
+			}
+		}
+
+		template <typename ...Args>
+		std::vector<field> make_row(const Args& ...args) const {
+			if (sizeof...(Args) != m_columns.size()) {
+				throw std::invalid_argument("write_behind_sink row size mismatch");
+			}
+			std::vector<field> row;
+			row.reserve(sizeof...(Args));
+			(row.push_back(detail::to_field(args)), ...);
+			return row;
+		}
+
+		void push(state& s, std::vector<field> row, std::vector<std::function<void()>>& waiters) const {
+			s.rows.push_back(std::move(row));
+			++s.stats.appended;
+			if (s.rows.size() == m_option.batch_rows) {
+				waiters = s.flusher_waiters.take();
+			}
+		}
+
+		template <typename F>
+		std::vector<std::function<void()>> update(F&& f, detail::waiter_list state::* list) {
+			std::unique_lock lock(m_state->mutex);
+			f(*m_state);
+			return ((*m_state).*list).take();
+		}
+
+		/**
+		 * @brief 后台刷出协程, 不持有 sink, sink 析构后刷完剩余行退出
+		 */
+		static awaitable<void> flusher(
+			std::shared_ptr<connection_pool> pool,
+			std::shared_ptr<state> s,
+			std::string table,
+			std::vector<std::string> columns,
+			write_behind_option opt
+		) {
+			auto column_list = fmt::format("{}", fmt::join(columns, ", "));
+			for (;;) {
+				co_await detail::wait_until(s, &state::flusher_waiters, [&opt](const state& s) {
+					return s.rows.size() >= opt.batch_rows || s.closing
+						|| (!s.rows.empty() && s.stats.appended - s.rows.size() < s.flush_target);
+				}, opt.flush_interval);
+				std::vector<std::vector<field>> batch;
+				std::vector<std::function<void()>> producers;
+				{
+					std::unique_lock lock(s->mutex);
+					if (s->rows.empty()) {
+						if (s->closing) {
+							break;
+						}
+						continue;
+					}
+					auto n = std::min(s->rows.size(), opt.batch_rows);
+					batch.reserve(n);
+					for (std::size_t i = 0; i < n; ++i) {
+						batch.push_back(std::move(s->rows.front()));
+						s->rows.pop_front();
+					}
+					producers = s->producer_waiters.take();
+				}
+				detail::waiter_list::notify(std::move(producers));
+				bool ok = false;
+				try {
+					auto conn = co_await pool->get(use_awaitable);
+					if (opt.copy_threshold == 0 || batch.size() >= opt.copy_threshold
+						|| batch.size() * columns.size() > 65535) {
+						co_await write_copy(conn, table, column_list, batch);
+					}
+					else {
+						co_await write_insert(conn, table, column_list, columns.size(), batch);
+					}
+					ok = true;
+				}
+				catch (const std::exception& ex) {
+					PQCPP_LOG_ERROR("write behind {} drop {} rows: {}", table, batch.size(), ex.what());
+				}
+				std::vector<std::function<void()>> drained;
+				{
+					std::unique_lock lock(s->mutex);
+					(ok ? s->stats.written : s->stats.failed) += batch.size();
+					++s->stats.batches;
+					drained = s->drain_waiters.take();
+				}
+				detail::waiter_list::notify(std::move(drained));
+			}
+			std::vector<std::function<void()>> drained;
+			{
+				std::unique_lock lock(s->mutex);
+				--s->flushers;
+				drained = s->drain_waiters.take();
+			}
+			detail::waiter_list::notify(std::move(drained));
+		}
+
+		static awaitable<void> write_insert(
+			std::shared_ptr<connection> conn,
+			const std::string& table,
+			const std::string& column_list,
+			std::size_t column_count,
+			std::vector<std::vector<field>>& batch
+		) {
+			std::string sql = fmt::format("INSERT INTO {} ({}) VALUES ", table, column_list);
+			std::vector<field> params;
+			params.reserve(batch.size() * column_count);
+			std::size_t index = 0;
+			for (std::size_t r = 0; r < batch.size(); ++r) {
+				sql += r ? ",(" : "(";
+				for (std::size_t c = 0; c < column_count; ++c) {
+					sql += fmt::format(c ? ",${}" : "${}", ++index);
+					params.push_back(std::move(batch[r][c]));
+				}
+				sql += ')';
+			}
+			auto q = std::make_shared<query>(std::move(sql));
+			q->set_parameter_fields(std::move(params));
+			throw_if_error(co_await conn->async_query(q, use_awaitable));
+		}
+
+		static awaitable<void> write_copy(
+			std::shared_ptr<connection> conn,
+			const std::string& table,
+			const std::string& column_list,
+			const std::vector<std::vector<field>>& batch
+		) {
+			std::string data;
+			for (const auto& row : batch) {
+				for (std::size_t c = 0; c < row.size(); ++c) {
+					if (c) {
+						data += '\t';
+					}
+					append_copy_field(data, row[c]);
+				}
+				data += '\n';
+			}
+			auto q = std::make_shared<query>(fmt::format("COPY {} ({}) FROM STDIN", table, column_list));
+			auto started = co_await conn->async_copy_start(q, use_awaitable);
+			throw_if_copy_error(started);
+			if (started.empty() || started.back()->status() != PGRES_COPY_IN) {
+				throw std::runtime_error("write-behind COPY did not enter COPY IN mode");
+			}
+			co_await conn->async_copy_write(boost::asio::buffer(data), use_awaitable);
+			throw_if_error(co_await conn->async_copy_end(use_awaitable));
+		}
+
+	private:
+		std::shared_ptr<connection_pool> m_pool;
+		std::string m_table;
+		std::vector<std::string> m_columns;
+		write_behind_option m_option;
+		std::shared_ptr<state> m_state;
+	};
+
+}